@@ -33,6 +33,12 @@ uint32_t GetVersion();
 //启动
 Status Start(const GlobalConfig& gconf);
 
+//获取后台merge队列状态(仅写模式)
+Status GetMergeQueueStat(MergeQueueStat& stat);
+
+//获取内存池状态
+Status GetMemoryStat(MemoryStat& stat);
+
 
 } 
 
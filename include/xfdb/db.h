@@ -35,8 +35,8 @@ public:
 	/**打开db, db路径不能以'/'结尾*/
 	static Status Open(const DBConfig& dbconf, const std::string& db_path, DBPtr& db);
 
-	/**删除db目录，db路径不能以'/'结尾*/
-	static Status Remove(const std::string& db_path);
+	/**删除db目录，db路径不能以'/'结尾；使用了data_paths时需传入打开时的配置，以删除其中的segment文件*/
+	static Status Remove(const std::string& db_path, const DBConfig& dbconf = DBConfig());
 
 public:	
     //获取db path
@@ -79,11 +79,17 @@ public:
 	Status Merge(const std::string& bucket_name);
 	Status Merge();						
 
+	//只合并key范围与[start_key, end_key)有重叠的segment，end_key为空时表示无上限(异步操作)
+	Status Merge(const std::string& bucket_name, const xfutil::StrView& start_key, const xfutil::StrView& end_key);
+
     //获取迭代器
     Status NewIterator(const std::string& bucket_name, IteratorPtr& iter);
 
-    //全量备份
-    Status Backup(const std::string& backup_dir);
+    //备份到backup_dir下的同名目录；incremental为true时目标目录可已存在，只拷贝其中没有的segment文件，并删除其中不再使用的文件
+    Status Backup(const std::string& backup_dir, bool incremental = false);
+
+    //在checkpoint_dir下的同名目录创建检查点，segment文件使用硬链接（不在同一文件系统时拷贝）
+    Status Checkpoint(const std::string& checkpoint_dir);
 
 private:
 	explicit DB(DBImplPtr& db);
@@ -21,6 +21,7 @@ limitations under the License.
 #include <atomic>
 #include <memory>
 #include <map>
+#include <vector>
 #include "xfdb/strutil.h"
 
 namespace xfdb 
@@ -95,29 +96,48 @@ struct GlobalConfig
 	uint64_t index_cache_size = 512ULL*1024*1024;
 	uint64_t data_cache_size = 1024ULL*1024*1024;
 	uint64_t bloom_filter_cache_size = 256ULL*1024*1024;
+	uint32_t max_open_files = 0;		//segment最多打开的文件数，超过时按LRU关闭不常用segment的文件和L1 index，用时再打开；0不限制
+	bool mmap_read = false;				//mmap读segment文件，块直接指向映射区而不经过index/data cache，适合数据可全部放入内存时
 
 	uint16_t notify_file_ttl_s = 30;	//通知文件生存周期，单位秒
 	std::string notify_dir;				//通知文件目录，不能以'/'结尾
+	bool shm_notify = false;			//写进程通过notify_dir下的共享内存环形缓冲区通知只读进程，不再写通知文件；只读进程开启后同时接收两种通知
 
 	std::string log_file_path;          //日志文件名
 
+	uint64_t io_rate_limit = 0;			//flush/merge/backup的io限速，单位字节/秒，0不限速
+	bool io_rate_auto_tune = false;		//根据前台读延时自动调整限速，不超过io_rate_limit
+	uint16_t backup_thread_num = 4;		//备份/检查点时并行拷贝segment文件的线程数，0或1表示顺序拷贝
+
+	uint32_t max_readahead_size = MB(1);	//迭代器顺序读时异步预读后续块，预读窗口从64KB起逐次翻倍到此值，0关闭
+	uint16_t open_thread_num = 8;			//打开db时并行打开bucket和segment的线程数，0或1表示顺序打开
+
 	//ReadConfig
 	bool auto_reload_db = true;
 	uint16_t reload_db_thread_num = 4;
+	bool lazy_open_segment = false;		//bucket meta中有key范围的segment在首次读时才打开index文件
+	std::string shared_cache_dir;		//非空时index/data/bloom filter cache放在此目录（如/dev/shm下）的共享内存文件中，同一主机上的只读进程共用；各进程cache大小需相同
 	
 	//WriteConfig
 	bool create_db_if_missing = true;
 
 	uint64_t write_cache_size = 256ULL*1024*1024;	//写缓存大小
+	bool use_huge_page = false;						//写缓存使用2MB大页以减少TLB缺失，先尝试MAP_HUGETLB（需预留大页），失败时使用透明大页
 	
 	uint16_t write_segment_thread_num = 8;
+	uint16_t write_io_thread_num = 4;			//所有正在写的segment共用的io线程数，使编码与写文件并行，0表示由编码线程直接写
+	uint32_t bytes_per_sync = MB(8);			//写segment时每写入此字节数发起一次异步回写，避免最后集中刷盘，0关闭
+	bool single_file_segment = true;			//新segment的data块与index写入同一文件；关闭时仍写index/data两个文件，旧格式均可读
 	uint16_t write_metadata_thread_num = 4;
 	
-	//uint8_t force_merge_deleted_percent = 1;	//百分比
+	uint8_t force_merge_deleted_percent = 30;	//segment中删除对象占比超过此百分比时，与更老的segment合并以消除删除标记；同时按删除占比提高层的合并优先级；0关闭
 	uint16_t part_merge_thread_num = 4;
 	uint16_t full_merge_thread_num = 2;
 	uint16_t merge_factor = 10;					//合并因子
 	uint64_t max_merge_size = GB(32);			//segment超过此值时不参与merge
+	bool merge_bypass_cache = true;				//merge读写segment时不占用page cache，避免挤出读请求所需的缓存
+	uint16_t bottom_rewrite_interval_s = 600;	//检测不参与merge的segment是否需要重写的时间间隔，单位秒，0关闭
+	uint8_t bottom_rewrite_garbage_percent = 50;	//不参与merge的segment中估算的垃圾占比超过此百分比时重写
 	
 	//uint64_t total_memtable_size = GB(2);		//总大小，超过时，阻塞写
 	uint32_t max_memtable_size = MB(64);		//1~1024
@@ -131,6 +151,67 @@ public:
 
 };
 
+//合并过滤器，merge时对set对象调用，可删除或修改对象；会被多个线程同时调用，需线程安全
+class CompactionFilter
+{
+public:
+	enum Decision
+	{
+		KEEP = 0,
+		REMOVE,
+		CHANGE_VALUE,
+	};
+
+	virtual ~CompactionFilter()
+	{}
+
+public:
+	//返回CHANGE_VALUE时，new_value为修改后的值
+	virtual Decision Filter(const xfutil::StrView& key, const xfutil::StrView& value, std::string& new_value) const = 0;
+
+	//读取时是否也过滤（仅REMOVE生效）
+	virtual bool FilterOnRead() const
+	{
+		return false;
+	}
+};
+typedef std::shared_ptr<CompactionFilter> CompactionFilterPtr;
+
+//TTL过滤器：value前8字节（小端）为写入时间（秒），超过ttl后在merge时删除，读取时不可见
+class TTLCompactionFilter : public CompactionFilter
+{
+public:
+	explicit TTLCompactionFilter(uint32_t ttl_s) : m_ttl_s(ttl_s)
+	{}
+
+public:
+	virtual Decision Filter(const xfutil::StrView& key, const xfutil::StrView& value, std::string& new_value) const override;
+
+	virtual bool FilterOnRead() const override
+	{
+		return true;
+	}
+
+	//在value前加上时间戳，timestamp为0时使用当前时间
+	static void MakeValue(const xfutil::StrView& value, std::string& ttl_value, uint64_t timestamp = 0);
+
+	//去掉时间戳，获取原始value
+	static xfutil::StrView GetValue(const xfutil::StrView& ttl_value);
+
+public:
+	static const uint32_t TIMESTAMP_SIZE = 8;
+
+private:
+	const uint32_t m_ttl_s;
+};
+
+//合并方式
+enum CompactionStyle : uint8_t
+{
+	COMPACTION_LEVEL = 0,	//分层合并
+	COMPACTION_FIFO,		//不合并，超过大小或时间限制时按新旧顺序直接删除最老的segment，适用于日志类数据
+};
+
 //bucket配置
 struct BucketConfig
 {
@@ -138,6 +219,12 @@ struct BucketConfig
 
 	uint8_t bloom_filter_bitnum = 10;			   //布隆bit数每key, 0关闭，segment级
     bool sync_data = false;                         //写data后是否立即刷盘
+
+	CompactionFilterPtr compaction_filter;			//合并过滤器，为空时不过滤
+
+	CompactionStyle compaction_style = COMPACTION_LEVEL;
+	uint64_t fifo_max_size = 0;						//FIFO模式下bucket的最大大小，0不限制
+	uint32_t fifo_ttl_s = 0;						//FIFO模式下segment的最长保留时间，单位秒，0不限制
 	//CompressionType compress_type = COMPRESSION_NONE;//只用在超过filter_size的块中;//暂不支持
 
 public:
@@ -145,12 +232,24 @@ public:
 
 };
 
+//segment文件的存放目录，可用于把segment分散到多块盘上，或把低层的segment放在较慢较便宜的盘上
+struct DataPath
+{
+	std::string path;				//目录，必须已存在，其下按<db目录名>/<bucket目录名>存放segment文件
+	uint8_t min_level = 0;			//存放level在[min_level, max_level]之间的segment
+	uint8_t max_level = 15;			
+};
+
 //db配置
 struct DBConfig
 {
 	//std::string wal_path; 				//暂不支持
 	bool create_bucket_if_missing = true;
 
+	//新segment按level选取覆盖该level的目录，有多个时轮流存放，没有时存放在db目录下；
+	//segment所在目录的序号记录在bucket meta中，因此只能在末尾追加，不能删除或调整顺序，读写进程的配置需相同
+	std::vector<DataPath> data_paths;
+
 public:
 	bool Check() const;
 
@@ -235,6 +334,39 @@ struct BucketStat
 	ObjectStat object_stat;
 	ReaderStat memwriter_stat;		//内存文件大小
 	ReaderStat segment_stat;		//segment文件大小
+	ReaderStat rewrite_stat;		//本进程重写不参与merge的segment的次数和大小，只在写进程中统计
+};
+
+//merge任务状态
+struct MergeTaskStat
+{
+	std::string db_path;
+	std::string bucket_name;
+	double score;					//合并分数，>=1时才会被调度
+};
+
+struct MergeQueueStat
+{
+	std::vector<MergeTaskStat> running_tasks;	//正在执行的任务
+	std::vector<MergeTaskStat> pending_tasks;	//待执行的任务，按分数从高到低排列
+};
+
+//内存块池状态
+struct BlockPoolStat
+{
+	uint32_t block_size;
+	uint32_t cache_num;			//预分配的缓存块数
+	uint32_t free_num;			//全局空闲的缓存块数，不含各线程弹匣中的块
+	uint64_t exhausted_num;		//缓存块用尽后从系统申请的累计次数，持续增长时应调大write_cache_size
+	uint64_t overflow_num;		//当前未释放的从系统申请的块数
+	uint64_t memory_size;		//占用的内存：缓存块+未释放的从系统申请的块
+	uint8_t huge_page;			//缓存块的大页方式：0未使用，1 MAP_HUGETLB，2透明大页(MADV_HUGEPAGE)
+};
+
+struct MemoryStat
+{
+	BlockPoolStat large_block_pool;		//写缓冲、flush/merge使用的大块
+	BlockPoolStat small_block_pool;		//小块
 };
 
 #ifdef DEBUG
@@ -0,0 +1,72 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#ifndef __xfdb_block_cache_h__
+#define __xfdb_block_cache_h__
+
+#include <string>
+#include "lru_cache.h"
+#include "shared_cache.h"
+
+namespace xfdb 
+{
+
+//index/data/bloom filter块的cache，默认为进程内LruCache，Attach成功后改用多进程共享的cache
+class BlockCache
+{
+public:
+	explicit BlockCache(size_t max_size) : m_max_size(max_size), m_lru_cache(max_size)
+	{}
+
+public:
+	/**在启动时调用，失败时仍使用进程内cache*/
+	inline bool Attach(const char* file_path)
+	{
+		return m_max_size != 0 && m_shared_cache.Open(file_path, m_max_size);
+	}
+
+	inline void Add(const std::string& key, const std::string& value, size_t value_size)
+	{
+		if(m_shared_cache.Opened())
+		{
+			m_shared_cache.Add(key, value, value_size);
+			return;
+		}
+		m_lru_cache.Add(key, value, value_size);
+	}
+	inline bool Get(const std::string& key, std::string& value)
+	{
+		if(m_shared_cache.Opened())
+		{
+			return m_shared_cache.Get(key, value);
+		}
+		return m_lru_cache.Get(key, value);
+	}
+
+private:
+	const size_t m_max_size;
+	xfutil::LruCache<std::string, std::string> m_lru_cache;
+	xfutil::SharedCache m_shared_cache;
+
+private:
+	BlockCache(const BlockCache&) = delete;
+	BlockCache& operator=(const BlockCache&) = delete;
+};
+
+}  
+
+#endif
+
@@ -14,13 +14,16 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ***************************************************************************/
 
+#include <set>
 #include "bucket.h"
 #include "bucketmeta_file.h"
 #include "object_reader_snapshot.h"
+#include "iterator_impl.h"
 #include "path.h"
 #include "logger.h"
 #include "engine.h"
 #include "directory.h"
+#include "thread.h"
 
 namespace xfdb 
 {
@@ -28,14 +31,14 @@ namespace xfdb
 Bucket::Bucket(DBImplPtr& db, const BucketInfo& info) 
 	: m_db(db), m_info(info), m_conf(db->GetConfig().GetBucketConfig(info.name))
 {
-	char bucket_path[MAX_PATH_LEN];
-	MakeBucketPath(db->GetPath().c_str(), info.name.c_str(), info.id, bucket_path);
-	m_bucket_path = bucket_path;
+	MakeSegmentPaths(db->GetPath().c_str(), db->GetConfig().data_paths, info.name.c_str(), info.id, m_segment_paths);
+	m_bucket_path = m_segment_paths[0];
 
 	m_next_object_id = MIN_OBJECT_ID;
 
 	m_next_segment_id = MIN_FILE_ID;
 	m_next_bucket_meta_fileid = MIN_FILE_ID;
+	m_base_meta_fileid = INVALID_FILE_ID;
 }
 
 Status Bucket::Open(const char* bucket_meta_filename)
@@ -64,6 +67,21 @@ Status Bucket::Open(const char* bucket_meta_filename)
 		assert(false);
 		return ERROR;
 	}	
+	s = ApplyBucketMetaEdit(fileid, bm);
+	if(s != OK)
+	{
+		return s;
+	}
+	//配置中的data_paths少于写入时，打开时会丢失segment
+	for(const auto& seg_stat : bm.alive_segment_stats)
+	{
+		if(seg_stat.path_id >= m_segment_paths.size())
+		{
+			LogWarn("segment(id=%lx) of bucket(%s) is in data path %u, but only %zu configured", 
+					seg_stat.segment_fileid, m_bucket_path.c_str(), seg_stat.path_id, m_segment_paths.size() - 1);
+			return ERR_INVALID_CONFIG;
+		}
+	}
 	
 	m_segment_rwlock.ReadLock();
 	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
@@ -94,19 +112,49 @@ Status Bucket::Open(const char* bucket_meta_filename)
 	return OK;
 }
 
+Status Bucket::ApplyBucketMetaEdit(fileid_t fileid, BucketMeta& bm)
+{
+	if(bm.base_fileid == INVALID_FILE_ID)
+	{
+		m_base_meta_fileid = fileid;
+		m_base_segment_stats = bm.alive_segment_stats;
+		return OK;
+	}
+	//全量文件只在写进程写入新的全量文件后才变化，通常只需合并新的增量
+	if(bm.base_fileid != m_base_meta_fileid)
+	{
+		BucketMetaFile base_file;
+		Status s = base_file.Open(m_bucket_path.c_str(), bm.base_fileid);
+		if(s != OK)
+		{
+			return s;
+		}
+		BucketMeta base_bm;
+		s = base_file.Read(base_bm);
+		if(s != OK)
+		{
+			return s;
+		}
+		if(base_bm.base_fileid != INVALID_FILE_ID)
+		{
+			return ERR_FILE_FORMAT;
+		}
+		m_base_meta_fileid = bm.base_fileid;
+		m_base_segment_stats.swap(base_bm.alive_segment_stats);
+	}
+	BucketMetaFile::ApplyEdit(m_base_segment_stats, bm);
+	return OK;
+}
+
 void Bucket::OpenSegment(const BucketMeta& bm, std::map<fileid_t, ObjectReaderPtr>& readers)
 {	
-	DBImplPtr db = m_db.lock();
-	assert(db);
-	
+	std::vector<const SegmentStat*> seg_stats;
+	seg_stats.reserve(bm.alive_segment_stats.size());
 	for(const auto& seg_stat : bm.alive_segment_stats)
 	{		
-        SegmentReaderPtr sr_ptr = NewSegmentReader();
-        if(sr_ptr->Open(m_bucket_path.c_str(), seg_stat) == OK)
-        {
-            readers[seg_stat.segment_fileid] = sr_ptr;
-        }
+		seg_stats.push_back(&seg_stat);
 	}
+	OpenSegment(seg_stats, readers);
 }
 
 void Bucket::OpenSegment(const BucketMeta& bm, const ObjectReaderSnapshot* last_snapshot, std::map<fileid_t, ObjectReaderPtr>& readers)
@@ -114,9 +162,7 @@ void Bucket::OpenSegment(const BucketMeta& bm, const ObjectReaderSnapshot* last_
     assert(last_snapshot != nullptr);
 	const std::map<fileid_t, ObjectReaderPtr>& last_readers = last_snapshot->Readers();
 	
-	DBImplPtr db = m_db.lock();
-	assert(db);
-	
+	std::vector<const SegmentStat*> seg_stats;
 	for(const auto& seg_stat : bm.alive_segment_stats)
 	{		
 		auto it = last_readers.find(seg_stat.segment_fileid);
@@ -126,16 +172,87 @@ void Bucket::OpenSegment(const BucketMeta& bm, const ObjectReaderSnapshot* last_
 		}
 		else
 		{
-			SegmentReaderPtr sr_ptr = NewSegmentReader();
-			if(sr_ptr->Open(m_bucket_path.c_str(), seg_stat) == OK)
-			{
-				readers[seg_stat.segment_fileid] = sr_ptr;
-			}
+			seg_stats.push_back(&seg_stat);
 		}
 	}
+	OpenSegment(seg_stats, readers);
+}
+
+void Bucket::OpenSegment(const std::vector<const SegmentStat*>& seg_stats, std::map<fileid_t, ObjectReaderPtr>& readers)
+{
+	bool lazy = LazyOpenSegment();
+	std::vector<SegmentReaderPtr> sr_ptrs(seg_stats.size());
+
+	ParallelFor(seg_stats.size(), Engine::GetEngine()->GetConfig().open_thread_num, [&](size_t i)
+	{
+        SegmentReaderPtr sr_ptr = NewSegmentReader();
+        if(sr_ptr->Open(SegmentPath(seg_stats[i]->path_id), *seg_stats[i], lazy) == OK)
+        {
+            sr_ptrs[i] = sr_ptr;
+        }
+	});
+
+	for(size_t i = 0; i < seg_stats.size(); ++i)
+	{
+		if(sr_ptrs[i])
+		{
+			readers[seg_stats[i]->segment_fileid] = sr_ptrs[i];
+		}
+	}
+}
+
+//拷贝或硬链接一个segment文件，先写到临时文件再改名，中断时不会留下不完整的segment文件
+static Status BackupSegmentFile(const char* src_path, const char* dst_path, const char* tmp_path, BackupType type, RateLimiter* limiter)
+{
+	//segment文件写完后不再修改，目标中已有同名同大小的文件时不用再拷贝
+	if(type == BACKUP_INCREMENTAL && File::Exist(dst_path) && File::Size(dst_path) == File::Size(src_path))
+	{
+		return OK;
+	}
+	//不在同一文件系统时硬链接失败，改为拷贝
+	if(type == BACKUP_CHECKPOINT && Path::HardLink(src_path, dst_path))
+	{
+		return OK;
+	}
+	if(!File::Copy(src_path, tmp_path, true, limiter) || !File::Rename(tmp_path, dst_path))
+	{
+		File::Remove(tmp_path);
+		LogWarn("backup %s to %s failed, errno: %d", src_path, dst_path, LastError);
+		return ERR_FILE_WRITE;
+	}
+	return OK;
 }
 
-Status Bucket::Backup(const std::string& db_dir)
+//删除增量备份目标中不再使用的bucket meta和segment文件
+static void RemoveStaleBackupFile(const char* bucket_path, fileid_t meta_fileid, const std::set<fileid_t>& segment_fileids)
+{
+	char path[MAX_PATH_LEN];
+
+	std::vector<FileName> names;
+	ListBucketMetaFile(bucket_path, names);
+	for(const auto& name : names)
+	{
+		if(strtoull(name.str, nullptr, 10) != meta_fileid)
+		{
+			Path::Combine(path, sizeof(path), bucket_path, name.str);
+			File::Remove(path);
+		}
+	}
+
+	names.clear();
+	ListFile(bucket_path, "*" INDEX_FILE_EXT, names);
+	ListFile(bucket_path, "*" DATA_FILE_EXT, names);
+	for(const auto& name : names)
+	{
+		if(segment_fileids.find(strtoull(name.str, nullptr, 16)) == segment_fileids.end())
+		{
+			Path::Combine(path, sizeof(path), bucket_path, name.str);
+			File::Remove(path);
+		}
+	}
+}
+
+Status Bucket::Backup(const std::string& db_dir, BackupType type)
 {
     char bucket_path[MAX_PATH_LEN];
     MakeBucketPath(db_dir.c_str(), m_info.name.c_str(), m_info.id, bucket_path);
@@ -143,38 +260,128 @@ Status Bucket::Backup(const std::string& db_dir)
     {
         return ERR_PATH_CREATE;
     }
-
-    char src_path[MAX_PATH_LEN];
-    char dst_path[MAX_PATH_LEN];
+    //上次增量备份中断时留下的临时文件
+    if(type == BACKUP_INCREMENTAL)
+    {
+        RemoveTempFile(bucket_path);
+    }
 
 	m_segment_rwlock.ReadLock();
 	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
 	m_segment_rwlock.ReadUnlock();
 
-    //先拷贝segment文件，再拷贝meta文件
-    if(reader_snapshot)
+    if(!reader_snapshot)
+    {
+        return OK;
+    }
+
+    std::vector<SegmentReaderPtr> seg_readers;
+    const std::map<fileid_t, ObjectReaderPtr>& readers = reader_snapshot->Readers();
+    seg_readers.reserve(readers.size());
+    for(auto it = readers.begin(); it != readers.end(); ++it)
+    {
+        SegmentReaderPtr seg_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+        if(seg_reader)
+        {
+            seg_readers.push_back(seg_reader);
+        }
+    }
+
+    //先拷贝segment文件，再拷贝meta文件；多个segment并行拷贝，共用一个限速器
+    RateLimiter* limiter = &Engine::GetEngine()->GetRateLimiter();
+    IOPriority priority = RateLimiter::GetThreadPriority();
+
+    std::vector<Status> results(seg_readers.size(), OK);
+    ParallelFor(seg_readers.size(), Engine::GetEngine()->GetConfig().backup_thread_num, [&](size_t i)
     {
-        const std::map<fileid_t, ObjectReaderPtr>& readers = reader_snapshot->Readers();
+        IOPriorityGuard io_guard(priority);
+
+        const SegmentStat& stat = seg_readers[i]->Stat();
+        fileid_t fileid = stat.segment_fileid;
+        const char* segment_path = SegmentPath(stat.path_id);
+        char src_path[MAX_PATH_LEN];
+        char dst_path[MAX_PATH_LEN];
+        char tmp_path[MAX_PATH_LEN];
 
-        for(auto it = readers.begin(); it != readers.end(); ++it)
+        //单文件segment没有data文件
+        MakeDataFilePath(segment_path, fileid, src_path);
+        if(File::Exist(src_path))
         {
-	        MakeDataFilePath(m_bucket_path.c_str(), it->first, src_path);
-	        MakeDataFilePath(bucket_path, it->first, dst_path);
-            File::Copy(src_path, dst_path);
+            MakeDataFilePath(bucket_path, fileid, dst_path);
+            MakeTmpDataFilePath(bucket_path, fileid, tmp_path);
+            results[i] = BackupSegmentFile(src_path, dst_path, tmp_path, type, limiter);
+            if(results[i] != OK)
+            {
+                return;
+            }
+        }
+
+        MakeIndexFilePath(segment_path, fileid, src_path);
+        MakeIndexFilePath(bucket_path, fileid, dst_path);
+        MakeTmpIndexFilePath(bucket_path, fileid, tmp_path);
+        results[i] = BackupSegmentFile(src_path, dst_path, tmp_path, type, limiter);
+    });
 
-            MakeIndexFilePath(m_bucket_path.c_str(), it->first, src_path);
-            MakeIndexFilePath(bucket_path, it->first, dst_path);
-            File::Copy(src_path, dst_path);
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        if(results[i] != OK)
+        {
+            return results[i];
         }
     }
+
+    //当前meta可能是增量文件，为备份写一个全量文件
+    BucketMeta bm;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        bm.max_level_num = m_conf.max_level_num;
+        bm.next_segment_id = m_next_segment_id;
+        bm.next_object_id = m_next_object_id;
+    }
+    std::set<fileid_t> segment_fileids;
+    bm.alive_segment_stats.reserve(seg_readers.size());
+    for(size_t i = 0; i < seg_readers.size(); ++i)
+    {
+        bm.alive_segment_stats.push_back(seg_readers[i]->Stat());
+        //备份中的segment都在bucket目录下
+        bm.alive_segment_stats.back().path_id = 0;
+        segment_fileids.insert(seg_readers[i]->Stat().segment_fileid);
+    }
     fileid_t meta_fileid = reader_snapshot->MetaFile()->FileID();
-    MakeBucketMetaFilePath(m_bucket_path.c_str(), meta_fileid, src_path);
-    MakeBucketMetaFilePath(bucket_path, meta_fileid, dst_path);
-    File::Copy(src_path, dst_path);
+    Status s = BucketMetaFile::Write(bucket_path, meta_fileid, bm);
+    if(s != OK)
+    {
+        return s;
+    }
 
+    //新meta写完后再删除旧文件，中断时目标中的旧meta仍然可用
+    if(type == BACKUP_INCREMENTAL)
+    {
+        RemoveStaleBackupFile(bucket_path, meta_fileid, segment_fileids);
+    }
     return OK;
 }
 
+bool Bucket::IsFilteredOnRead(const StrView& key, const std::string& value) const
+{
+	const CompactionFilterPtr& filter = m_conf.compaction_filter;
+	if(!filter || !filter->FilterOnRead())
+	{
+		return false;
+	}
+	std::string new_value;
+	return filter->Filter(key, StrView(value.data(), value.size()), new_value) == CompactionFilter::REMOVE;
+}
+
+void Bucket::FilterOnRead(IteratorImplPtr& iter) const
+{
+	const CompactionFilterPtr& filter = m_conf.compaction_filter;
+	if(filter && filter->FilterOnRead())
+	{
+		iter = NewCompactionFilterIterator(iter, filter, true, true);
+	}
+}
+
 }  // namespace xfdb
 
 
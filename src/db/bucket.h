@@ -70,24 +70,56 @@ public:
 	{
 		return ERR_INVALID_MODE;
 	}
+	virtual Status Merge(const StrView& start_key, const StrView& end_key)
+	{
+		return ERR_INVALID_MODE;
+	}
 	virtual Status Clean()
 	{
 		return ERR_INVALID_MODE;
 	}
+	//bottom_rewrite: 是否检测需重写的segment
+	virtual Status CheckCompaction(bool bottom_rewrite)
+	{
+		return ERR_INVALID_MODE;
+	}
 	virtual void GetStat(BucketStat& stat) const = 0;
 	
 public:	
 	Status Open(const char* bucket_meta_filename);
-    Status Backup(const std::string& db_dir);
+    Status Backup(const std::string& db_dir, BackupType type);
 	
 protected:
+	//读取时过滤：对象是否已被CompactionFilter删除（如TTL过期但尚未merge）
+	bool IsFilteredOnRead(const StrView& key, const std::string& value) const;
+	void FilterOnRead(IteratorImplPtr& iter) const;
+
 	void OpenSegment(const BucketMeta& bm, const ObjectReaderSnapshot* last_snapshot, std::map<fileid_t, ObjectReaderPtr>& readers);
     void OpenSegment(const BucketMeta& bm, std::map<fileid_t, ObjectReaderPtr>& readers);
+	//用open_thread_num个线程并行打开
+	void OpenSegment(const std::vector<const SegmentStat*>& seg_stats, std::map<fileid_t, ObjectReaderPtr>& readers);
+
+	//bm为增量时合并到全量上（需持有m_mutex）
+	Status ApplyBucketMetaEdit(fileid_t fileid, BucketMeta& bm);
+
+	//是否在首次读时才打开segment文件
+	virtual bool LazyOpenSegment() const
+	{
+		return false;
+	}
+
+	//segment文件所在目录，path_id已在Open时检查
+	inline const char* SegmentPath(uint8_t path_id) const
+	{
+		assert(path_id < m_segment_paths.size());
+		return m_segment_paths[path_id].c_str();
+	}
 
 protected:
 	const DBImplWptr m_db;
 	const BucketInfo m_info;
 	std::string m_bucket_path;
+	std::vector<std::string> m_segment_paths;	//见MakeSegmentPaths，[0]即m_bucket_path
 
 	std::mutex m_mutex;
     BucketConfig m_conf;
@@ -99,6 +131,10 @@ protected:
 
 	ObjectReaderSnapshotPtr m_reader_snapshot;
 
+	//最近的全量bucket meta，用于合并增量文件，受m_mutex保护
+	fileid_t m_base_meta_fileid;
+	std::vector<SegmentStat> m_base_segment_stats;
+
 private:
 	friend class DBImpl;
 	Bucket(const Bucket&) = delete;
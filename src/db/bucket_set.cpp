@@ -62,6 +62,14 @@ void BucketSet::Clean()
 	}
 }
 
+void BucketSet::CheckCompaction(bool bottom_rewrite)
+{
+	for(auto it = m_buckets.begin(); it != m_buckets.end(); ++it)
+	{
+		it->second->CheckCompaction(bottom_rewrite);
+	}
+}
+
 void BucketSet::List(std::vector<std::string>& bucket_names) const
 {
 	bucket_names.resize(m_buckets.size());
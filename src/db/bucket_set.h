@@ -38,6 +38,7 @@ public:
 	void Flush();
 	void Merge();
 	void Clean();
+	void CheckCompaction(bool bottom_rewrite);
 	
 	inline const std::map<std::string, BucketPtr>& Buckets() const
 	{
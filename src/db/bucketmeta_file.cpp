@@ -32,16 +32,27 @@ enum
 	MID_L2INDEX_META_SIZE,
 	MID_INDEX_FILESIZE,
 	MID_DATA_FILESIZE,
+	MID_MIN_KEY,
+	MID_MAX_KEY,
+	MID_MAX_OBJECT_ID,
+	MID_SEGMENT_MAX_MERGE_SEGMENT_ID,
+	MID_SET_STAT,
+	MID_DELETE_STAT,
+	MID_APPEND_STAT,
+	MID_PATH_ID,
 	
 	MID_NEXT_SEGMENT_ID = 20,
 	MID_NEXT_OBJECT_ID,
 	MID_MAX_LEVEL_NUM_ID,
     MID_MAX_MERGE_SEGMENT_ID,
+	MID_BASE_FILEID,
+	MID_REMOVED_SEGMENT_FILEIDS,
 };
 
 BucketMetaFile::BucketMetaFile()
 {
 	m_id = INVALID_FILE_ID;
+	m_base_id = INVALID_FILE_ID;
 }
 
 BucketMetaFile::~BucketMetaFile()
@@ -75,6 +86,21 @@ Status BucketMetaFile::Open(const char* bucket_path, const char* filename, LockF
 	return OK;
 }
 
+static void ParseObjectStat(const byte_t*& data, const byte_t* data_end, TypeObjectStat& stat)
+{
+	stat.count = DecodeV64(data, data_end);
+	stat.key_size = DecodeV64(data, data_end);
+	stat.value_size = DecodeV64(data, data_end);
+}
+
+static byte_t* EncodeObjectStat(byte_t* ptr, uint32_t id, const TypeObjectStat& stat)
+{
+	ptr = EncodeV32(ptr, id);
+	ptr = EncodeV64(ptr, stat.count);
+	ptr = EncodeV64(ptr, stat.key_size);
+	return EncodeV64(ptr, stat.value_size);
+}
+
 static const bool ParseSegmentFileInfo(const byte_t*& data, const byte_t* data_end, SegmentStat& info)
 {
 	for(;;)
@@ -94,6 +120,36 @@ static const bool ParseSegmentFileInfo(const byte_t*& data, const byte_t* data_e
 		case MID_DATA_FILESIZE:
 			info.data_filesize = DecodeV64(data, data_end);
 			break;
+		case MID_MIN_KEY:
+			{
+				StrView key = DecodeString(data, data_end);
+				info.min_key.assign(key.data, key.size);
+			}
+			break;
+		case MID_MAX_KEY:
+			{
+				StrView key = DecodeString(data, data_end);
+				info.max_key.assign(key.data, key.size);
+			}
+			break;
+		case MID_MAX_OBJECT_ID:
+			info.max_object_id = DecodeV64(data, data_end);
+			break;
+		case MID_SEGMENT_MAX_MERGE_SEGMENT_ID:
+			info.max_merge_segment_id = DecodeV64(data, data_end);
+			break;
+		case MID_SET_STAT:
+			ParseObjectStat(data, data_end, info.object_stat.set_stat);
+			break;
+		case MID_DELETE_STAT:
+			ParseObjectStat(data, data_end, info.object_stat.delete_stat);
+			break;
+		case MID_APPEND_STAT:
+			ParseObjectStat(data, data_end, info.object_stat.append_stat);
+			break;
+		case MID_PATH_ID:
+			info.path_id = DecodeV32(data, data_end);
+			break;
 		case MID_END:
 			return true;
 			break;
@@ -121,6 +177,19 @@ static const bool ParseSegmentMeta(const byte_t*& data, const byte_t* data_end,
 		case MID_MAX_LEVEL_NUM_ID:
 			bm.max_level_num = DecodeV32(data, data_end);
 			break;
+		case MID_BASE_FILEID:
+			bm.base_fileid = DecodeV64(data, data_end);
+			break;
+		case MID_REMOVED_SEGMENT_FILEIDS:
+			{
+				uint32_t cnt = DecodeV32(data, data_end);
+				bm.removed_segment_fileids.resize(cnt);
+				for(uint32_t i = 0; i < cnt; ++i)
+				{
+					bm.removed_segment_fileids[i] = DecodeV64(data, data_end);
+				}
+			}
+			break;
 		case MID_END:
 			return true;
 			break;
@@ -179,7 +248,33 @@ Status BucketMetaFile::Read(BucketMeta& bm)
 		return s;
 	}
 	
-	return Parse((byte_t*)str.Data(), str.Size(), bm);
+	s = Parse((byte_t*)str.Data(), str.Size(), bm);
+	if(s == OK)
+	{
+		m_base_id = bm.base_fileid;
+	}
+	return s;
+}
+
+void BucketMetaFile::ApplyEdit(const std::vector<SegmentStat>& base_stats, BucketMeta& bm)
+{
+	assert(bm.base_fileid != INVALID_FILE_ID);
+	std::set<fileid_t> removed_fileids(bm.removed_segment_fileids.begin(), bm.removed_segment_fileids.end());
+
+	std::vector<SegmentStat> alive_stats;
+	alive_stats.reserve(base_stats.size() + bm.alive_segment_stats.size());
+	for(const auto& stat : base_stats)
+	{
+		if(removed_fileids.find(stat.segment_fileid) == removed_fileids.end())
+		{
+			alive_stats.push_back(stat);
+		}
+	}
+	for(auto& stat : bm.alive_segment_stats)
+	{
+		alive_stats.push_back(std::move(stat));
+	}
+	bm.alive_segment_stats.swap(alive_stats);
 }
 
 Status BucketMetaFile::Write(const char* bucket_path, fileid_t fileid, BucketMeta& bm)
@@ -217,6 +312,21 @@ Status BucketMetaFile::Serialize(const BucketMeta& bm, String& str)
 		ptr = EncodeV32(ptr, MID_L2INDEX_META_SIZE, sinfo.L2index_meta_size);
 		ptr = EncodeV64(ptr, MID_INDEX_FILESIZE, sinfo.index_filesize);
 		ptr = EncodeV64(ptr, MID_DATA_FILESIZE, sinfo.data_filesize);
+		if(!sinfo.max_key.empty())
+		{
+			ptr = EncodeString(ptr, MID_MIN_KEY, sinfo.min_key.data(), sinfo.min_key.size());
+			ptr = EncodeString(ptr, MID_MAX_KEY, sinfo.max_key.data(), sinfo.max_key.size());
+			ptr = EncodeV64(ptr, MID_MAX_OBJECT_ID, sinfo.max_object_id);
+			ptr = EncodeV64(ptr, MID_SEGMENT_MAX_MERGE_SEGMENT_ID, sinfo.max_merge_segment_id);
+			ptr = EncodeObjectStat(ptr, MID_SET_STAT, sinfo.object_stat.set_stat);
+			ptr = EncodeObjectStat(ptr, MID_DELETE_STAT, sinfo.object_stat.delete_stat);
+			ptr = EncodeObjectStat(ptr, MID_APPEND_STAT, sinfo.object_stat.append_stat);
+		}
+		//不使用data_paths时不写，与旧版本兼容
+		if(sinfo.path_id != 0)
+		{
+			ptr = EncodeV32(ptr, MID_PATH_ID, sinfo.path_id);
+		}
 		ptr = EncodeV32(ptr, MID_END);
 	}
 
@@ -239,6 +349,17 @@ Status BucketMetaFile::Serialize(const BucketMeta& bm, String& str)
 	ptr = EncodeV64(ptr, MID_NEXT_SEGMENT_ID, bm.next_segment_id);
 	ptr = EncodeV64(ptr, MID_NEXT_OBJECT_ID, bm.next_object_id);
 	ptr = EncodeV32(ptr, MID_MAX_LEVEL_NUM_ID, bm.max_level_num);
+	if(bm.base_fileid != INVALID_FILE_ID)
+	{
+		ptr = EncodeV64(ptr, MID_BASE_FILEID, bm.base_fileid);
+
+		cnt = bm.removed_segment_fileids.size();
+		ptr = EncodeV32(ptr, MID_REMOVED_SEGMENT_FILEIDS, cnt);
+		for(uint32_t i = 0; i < cnt; ++i)
+		{
+			ptr = EncodeV64(ptr, bm.removed_segment_fileids[i]);
+		}
+	}
 	ptr = EncodeV32(ptr, MID_END);
 
 	ptr = Encode32(ptr, 0);	//FIXME:crc填0
@@ -250,47 +371,69 @@ Status BucketMetaFile::Serialize(const BucketMeta& bm, String& str)
 
 static constexpr uint32_t EstimateSegmentFileInfoSize()
 {
-	return (MAX_V64_SIZE + MAX_V32_SIZE)*5 /*5个属性*/;
+	return (MAX_V64_SIZE + MAX_V32_SIZE)*10 /*10个属性，不含key*/ + (MAX_V32_SIZE + 3*MAX_V64_SIZE)*MaxObjectType /*object统计*/;
 }	
 static constexpr uint32_t EstimateSegmentMetaSize()
 {
-	return (MAX_V32_SIZE + MAX_V64_SIZE)*2 /*2个属性*/;
+	return (MAX_V32_SIZE + MAX_V64_SIZE)*5 /*5个属性，不含removed_segment_fileids*/;
 }	
 
 uint32_t BucketMetaFile::EstimateSize(const BucketMeta& bm)
 {
 	uint32_t size = FILE_HEAD_SIZE;
 	size += MAX_V32_SIZE + bm.alive_segment_stats.size() * EstimateSegmentFileInfoSize();
+	for(const auto& sinfo : bm.alive_segment_stats)
+	{
+		size += sinfo.min_key.size() + sinfo.max_key.size();
+	}
 	size += MAX_V32_SIZE + bm.merged_segment_fileids.size() * MAX_V64_SIZE;
 	size += MAX_V32_SIZE + bm.new_segment_fileids.size() * MAX_V64_SIZE;
+	size += bm.removed_segment_fileids.size() * MAX_V64_SIZE;
 	size += EstimateSegmentMetaSize();
 	size += sizeof(uint32_t)/*crc*/;
 	return size;
 }
 
-Status BucketMetaFile::Remove(const char* bucket_path, const char* file_name)
+Status BucketMetaFile::Remove(const std::vector<std::string>& segment_paths, const char* file_name, bool cleaned)
 {
-	Status s = Clean(bucket_path, file_name, LF_TRY_WRITE);
+	Status s;
+	if(cleaned)
+	{
+		//只确认没有进程读该meta
+		BucketMetaFile mfile;
+		s = mfile.Open(segment_paths[0].c_str(), file_name, LF_TRY_WRITE);
+	}
+	else
+	{
+		s = Clean(segment_paths, file_name, LF_TRY_WRITE);
+	}
 	if(s != OK)
 	{
 		return s;
 	}
 
 	char file_path[MAX_PATH_LEN];
-	Path::Combine(file_path, sizeof(file_path), bucket_path, file_name);
+	Path::Combine(file_path, sizeof(file_path), segment_paths[0].c_str(), file_name);
 	return File::Remove(file_path) ? OK : ERR_PATH_DELETE;
 }
 
-Status BucketMetaFile::Clean(const char* bucket_path, const char* file_name)
+Status BucketMetaFile::Clean(const std::vector<std::string>& segment_paths, const char* file_name)
 {
-	return Clean(bucket_path, file_name, LF_TRY_READ);
+	return Clean(segment_paths, file_name, LF_TRY_READ);
 }
 
-Status BucketMetaFile::Clean(const char* bucket_path, const char* file_name, LockFlag flag)
+Status BucketMetaFile::CleanUnused(const std::vector<std::string>& segment_paths, const char* file_name)
 {
+	return Clean(segment_paths, file_name, LF_TRY_WRITE);
+}
+
+Status BucketMetaFile::Clean(const std::vector<std::string>& segment_paths, const char* file_name, LockFlag flag)
+{
+	assert(!segment_paths.empty());
+
 	//尝试写锁打开meta文件，删除待删除的segment文件
 	BucketMetaFile mfile;
-	Status s = mfile.Open(bucket_path, file_name, flag);
+	Status s = mfile.Open(segment_paths[0].c_str(), file_name, flag);
 	if(s != OK)
 	{
 		return s;
@@ -301,12 +444,16 @@ Status BucketMetaFile::Clean(const char* bucket_path, const char* file_name, Loc
 	{
 		return s;
 	}
+	//meta中只记录了待删除的fileid，在所有目录下删除（不存在时忽略）
 	for(auto id : bm.merged_segment_fileids)
 	{
-		s = SegmentWriter::Remove(bucket_path, id);
-		if(s != OK)
+		for(const auto& path : segment_paths)
 		{
-			return s;
+			s = SegmentWriter::Remove(path.c_str(), id);
+			if(s != OK)
+			{
+				return s;
+			}
 		}
 	}
 
@@ -25,6 +25,9 @@ limitations under the License.
 namespace xfdb 
 {
 
+/**bucket meta文件分为两种：
+   全量文件（base_fileid无效），alive_segment_stats为全部segment；
+   增量文件，只记录相对于全量文件base_fileid的变化：alive_segment_stats为之后新增的segment，removed_segment_fileids为之后删除的segment*/
 struct BucketMeta
 {		
 	std::vector<SegmentStat> alive_segment_stats;
@@ -34,11 +37,15 @@ struct BucketMeta
 	fileid_t next_segment_id;
 	objectid_t next_object_id;
 
+	fileid_t base_fileid;							//增量文件所基于的全量文件
+	std::vector<fileid_t> removed_segment_fileids;	//增量文件中已删除的segment
+
 	BucketMeta()
 	{
 		max_level_num = MAX_LEVEL_ID;
 		next_segment_id = MIN_FILE_ID;
 		next_object_id = MIN_OBJECT_ID;
+		base_fileid = INVALID_FILE_ID;
 	}
 };
 
@@ -51,18 +58,30 @@ public:
 public:	
 	Status Open(const char* bucket_path, fileid_t fileid, LockFlag type = LF_NONE);
 	Status Open(const char* bucket_path, const char* filename, LockFlag type = LF_NONE);
+	/**增量文件读出的是增量，需用ApplyEdit合并到全量上*/
 	Status Read(BucketMeta& bm);
 	inline fileid_t FileID()
 	{
 		return m_id;
 	}
+	//增量文件所基于的全量文件，全量文件为INVALID_FILE_ID，Read后有效
+	inline fileid_t BaseFileID()
+	{
+		return m_base_id;
+	}
+	
+	/**将增量bm合并到全量的base_stats上，bm.alive_segment_stats变为全部segment*/
+	static void ApplyEdit(const std::vector<SegmentStat>& base_stats, BucketMeta& bm);
 	
 	//
 	static Status Write(const char* bucket_path, fileid_t fileid, BucketMeta& bm);
+	//segment_paths见MakeSegmentPaths，meta文件在segment_paths[0]下，待删除的segment文件可能在其中任一目录下
 	//清理meta中待删除的segment文件
-	static Status Clean(const char* bucket_path, const char* file_name);
-	//移除meta中待删除的segment文件，并删除meta文件
-	static Status Remove(const char* bucket_path, const char* file_name);
+	static Status Clean(const std::vector<std::string>& segment_paths, const char* file_name);
+	//没有进程读该meta时清理其待删除的segment文件，但保留meta文件（仍被增量文件依赖的全量文件）
+	static Status CleanUnused(const std::vector<std::string>& segment_paths, const char* file_name);
+	//移除meta中待删除的segment文件，并删除meta文件；cleaned为true表示segment文件已清理过，只删除meta文件
+	static Status Remove(const std::vector<std::string>& segment_paths, const char* file_name, bool cleaned = false);
 
 private:
 	static Status Parse(const byte_t* data, uint32_t size, BucketMeta& bm);
@@ -70,11 +89,12 @@ private:
 	static uint32_t EstimateSize(const BucketMeta& bm);
 
 	//清理meta中待删除的segment文件
-	static Status Clean(const char* bucket_path, const char* file_name, LockFlag flag);
+	static Status Clean(const std::vector<std::string>& segment_paths, const char* file_name, LockFlag flag);
 
 private:
 	File m_file;
 	fileid_t m_id;
+	fileid_t m_base_id;
 	
 private:
 	BucketMetaFile(const BucketMetaFile&) = delete;
@@ -0,0 +1,64 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+
+#include <time.h>
+#include "xfdb/types.h"
+#include "coding.h"
+
+using namespace xfutil;
+
+namespace xfdb 
+{
+
+CompactionFilter::Decision TTLCompactionFilter::Filter(const StrView& key, const StrView& value, std::string& new_value) const
+{
+	//没有时间戳的value不处理
+	if(value.size < TIMESTAMP_SIZE)
+	{
+		return KEEP;
+	}
+	const byte_t* ptr = (const byte_t*)value.data;
+	uint64_t timestamp = Decode64(ptr);
+
+	return ((uint64_t)time(nullptr) >= timestamp + m_ttl_s) ? REMOVE : KEEP;
+}
+
+void TTLCompactionFilter::MakeValue(const StrView& value, std::string& ttl_value, uint64_t timestamp)
+{
+	if(timestamp == 0)
+	{
+		timestamp = time(nullptr);
+	}
+	byte_t buf[TIMESTAMP_SIZE];
+	Encode64(buf, timestamp);
+
+	ttl_value.reserve(TIMESTAMP_SIZE + value.size);
+	ttl_value.assign((char*)buf, TIMESTAMP_SIZE);
+	ttl_value.append(value.data, value.size);
+}
+
+StrView TTLCompactionFilter::GetValue(const StrView& ttl_value)
+{
+	if(ttl_value.size < TIMESTAMP_SIZE)
+	{
+		return ttl_value;
+	}
+	return StrView(ttl_value.data + TIMESTAMP_SIZE, ttl_value.size - TIMESTAMP_SIZE);
+}
+
+}  
+
@@ -26,12 +26,13 @@ limitations under the License.
 #include "key_util.h"
 #include "coding.h"
 #include "engine.h"
+#include "data_file.h"
 
 namespace xfdb 
 {
 
-DataBlockReader::DataBlockReader(const File& file, const std::string& file_path) 
-	: m_file(file), m_file_path(file_path)
+DataBlockReader::DataBlockReader(const DataReader& data_reader, bool fill_cache) 
+	: m_data_reader(data_reader), m_fill_cache(fill_cache)
 {
 
 }
@@ -42,29 +43,46 @@ DataBlockReader::~DataBlockReader()
 
 Status DataBlockReader::Read(const SegmentL0Index& L0_index)
 {
+	//文件已映射时直接指向映射区，不经过cache
+	const FileMapping& mapping = *m_data_reader.m_mapping;
+	if(mapping.Mapped())
+	{
+		if(L0_index.L0offset + L0_index.L0compress_size > mapping.Size())
+		{
+			return ERR_FILE_READ;
+		}
+		m_data.Set((char*)mapping.Data() + L0_index.L0offset, L0_index.L0compress_size);
+		m_L0Index = L0_index;
+		return OK;
+	}
+
 	//读取L1块 cache
-	auto& cache = Engine::GetEngine()->GetDataCache();
+	EnginePtr& engine = Engine::GetEngine();
+	auto& cache = engine->GetDataCache();
 
-	std::string cache_key = m_file_path;
-	cache_key.append((char*)&L0_index.L0offset, sizeof(L0_index.L0offset));
+	std::string cache_key = CacheKey(m_data_reader.m_cache_key_prefix, L0_index.L0offset);
 
-	std::string data;
+	std::string& data = m_buf;
 	if(!cache.Get(cache_key, data) || data.size() < L0_index.L0compress_size)
 	{
 		data.resize(L0_index.L0compress_size);
-		int64_t r_size = m_file.Read(L0_index.L0offset, (void*)data.data(), L0_index.L0compress_size);
+		IOReadGuard io_guard(engine->GetRateLimiter(), L0_index.L0compress_size);
+		int64_t r_size = m_data_reader.m_file->Read(L0_index.L0offset, (void*)data.data(), L0_index.L0compress_size);
 		if((uint64_t)r_size != L0_index.L0compress_size)
 		{
 			assert(false);
 			return ERR_FILE_READ;
 		}
-		cache.Add(cache_key, data, data.size());
+		if(m_fill_cache)
+		{
+			cache.Add(cache_key, data, data.size());
+		}
 	}
 	
 	//TODO: 是否要解压
 
 	assert(!data.empty());
-	m_data = data;
+	m_data.Set(data.data(), data.size());
 	m_L0Index = L0_index;
 	return OK;
 }
@@ -183,7 +201,7 @@ Status DataBlockReader::SearchBlock(const byte_t* block, uint32_t block_size, co
 
 Status DataBlockReader::Search(const StrView& key, ObjectType& type, std::string& value)
 {
-	return SearchBlock((byte_t*)m_data.data(), m_L0Index.L0compress_size, m_L0Index, key, type, value);
+	return SearchBlock((byte_t*)m_data.data, m_L0Index.L0compress_size, m_L0Index, key, type, value);
 }
 
 Status DataBlockReader::ParseGroup(const byte_t* group, uint32_t group_size, const L0GroupIndex& group_index, DataBlockReaderIteratorPtr& iter_ptr) const
@@ -282,7 +300,7 @@ DataBlockReaderIteratorPtr DataBlockReader::NewIterator()
 {
 	DataBlockReaderIteratorPtr iter_ptr = NewDataBlockReaderIterator(*this);
 
-	ParseBlock((byte_t*)m_data.data(), m_L0Index.L0compress_size, m_L0Index, iter_ptr);
+	ParseBlock((byte_t*)m_data.data, m_L0Index.L0compress_size, m_L0Index, iter_ptr);
 	iter_ptr->First();
 	return iter_ptr;
 }
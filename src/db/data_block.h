@@ -29,6 +29,7 @@ limitations under the License.
 namespace xfdb 
 {
 
+class DataReader;
 class DataBlockReaderIterator;
 typedef std::shared_ptr<DataBlockReaderIterator> DataBlockReaderIteratorPtr;
 #define NewDataBlockReaderIterator 	std::make_shared<DataBlockReaderIterator>
@@ -36,7 +37,8 @@ typedef std::shared_ptr<DataBlockReaderIterator> DataBlockReaderIteratorPtr;
 class DataBlockReader
 {
 public:
-	DataBlockReader(const File& file, const std::string& file_path);
+	//fill_cache: 读取的块是否加入data cache
+	explicit DataBlockReader(const DataReader& data_reader, bool fill_cache = true);
 	~DataBlockReader();
 	
 public:	
@@ -44,6 +46,13 @@ public:
 	Status Search(const StrView& key, ObjectType& type, std::string& value);
 	DataBlockReaderIteratorPtr NewIterator();
 
+	static inline std::string CacheKey(const std::string& key_prefix, uint64_t offset)
+	{
+		std::string cache_key = key_prefix;
+		cache_key.append((char*)&offset, sizeof(offset));
+		return cache_key;
+	}
+
 private:
 	Status SearchGroup(const byte_t* group, uint32_t group_size, const L0GroupIndex& group_index, const StrView& key, ObjectType& type, std::string& value) const;
 	Status SearchL2Group(const byte_t* group_start, uint32_t group_size, const LnGroupIndex& lngroup_index, const StrView& key, ObjectType& type, std::string& value) const;
@@ -54,10 +63,11 @@ private:
 	Status ParseBlock(const byte_t* block, uint32_t block_size, const SegmentL0Index& L0_index, DataBlockReaderIteratorPtr& iter_ptr) const;
 
 private:
-	const File& m_file;
-	const std::string& m_file_path;
+	const DataReader& m_data_reader;
+	const bool m_fill_cache;
 
-	std::string m_data;
+	std::string m_buf;
+	StrView m_data;			//指向m_buf或文件映射区
 	SegmentL0Index m_L0Index;
 
 private:
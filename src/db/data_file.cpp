@@ -29,7 +29,7 @@ using namespace xfutil;
 namespace xfdb 
 {
 
-DataReader::DataReader() : m_large_block_pool(Engine::GetEngine()->GetLargeBlockPool())
+DataReader::DataReader() : m_file(&m_data_file), m_mapping(&m_data_mapping), m_large_block_pool(Engine::GetEngine()->GetLargeBlockPool())
 {
 }
 DataReader::~DataReader()
@@ -41,18 +41,32 @@ Status DataReader::Open(const char* bucket_path, fileid_t fileid)
 	char data_path[MAX_PATH_LEN];
 	MakeDataFilePath(bucket_path, fileid, data_path);
 	
-	if(!m_file.Open(data_path, OF_READONLY))
+	if(!m_data_file.Open(data_path, OF_READONLY))
 	{
 		return ERR_FILE_READ;
 	}
-	m_path = data_path;
+	MakeCacheKeyPrefix(data_path, m_data_file, m_cache_key_prefix);
+
+	//点查为主，关闭映射区的预读；映射失败时退化为pread
+	if(Engine::GetEngine()->GetConfig().mmap_read)
+	{
+		m_data_mapping.Map(m_data_file, MADV_RANDOM);
+	}
 	return OK;
 }
 
+void DataReader::Open(const IndexReader& index_reader)
+{
+	assert(index_reader.IsSingleFile());
+	m_file = &index_reader.m_file;
+	m_mapping = &index_reader.m_mapping;
+	m_cache_key_prefix = index_reader.m_cache_key_prefix;
+}
+
 
 Status DataReader::Search(const SegmentL0Index& L0_index, const StrView& key, ObjectType& type, std::string& value) const
 {
-	DataBlockReader block(m_file, m_path);
+	DataBlockReader block(*this);
 	Status s = block.Read(L0_index);
 	if(s != OK)
 	{
@@ -66,30 +80,38 @@ Status DataReader::Search(const SegmentL0Index& L0_index, const StrView& key, Ob
 
 
 DataWriter::DataWriter(const BucketConfig& bucket_conf, BlockPool& pool, IndexWriter& index_writer)
-	: m_bucket_conf(bucket_conf), m_index_writer(index_writer), m_large_block_pool(pool), m_key_buf(pool)
+	: m_bucket_conf(bucket_conf), m_index_writer(index_writer), m_large_block_pool(pool), 
+	  m_rate_limiter(Engine::GetEngine()->GetRateLimiter()), m_async_writer(m_file, pool, m_rate_limiter, Engine::GetEngine()->GetAsyncWritePool()), m_key_buf(pool)
 {	
 	m_offset = 0;
+	m_bypass_cache = false;
+	m_single_file = false;
 	m_block_start = m_large_block_pool.Alloc();
 	m_block_end = m_block_start + m_large_block_pool.BlockSize();
 	m_block_ptr = m_block_start;
 
     m_prev_key.Reserve(1024);
+	memset(&m_stat, 0x00, sizeof(m_stat));
 }
 
 DataWriter::~DataWriter()
 {
-	m_file.Close();
-	
-	char file_path[MAX_PATH_LEN], tmp_file_path[MAX_PATH_LEN];
-	MakeTmpDataFilePath(m_bucket_path, m_segment_fileid, tmp_file_path);
-	MakeDataFilePath(m_bucket_path, m_segment_fileid, file_path);
+	if(!m_single_file)
+	{
+		m_async_writer.Finish();
+		m_file.Close();
+		
+		char file_path[MAX_PATH_LEN], tmp_file_path[MAX_PATH_LEN];
+		MakeTmpDataFilePath(m_bucket_path, m_segment_fileid, tmp_file_path);
+		MakeDataFilePath(m_bucket_path, m_segment_fileid, file_path);
 
-	File::Rename(tmp_file_path, file_path);
+		File::Rename(tmp_file_path, file_path);
+	}
 
 	m_large_block_pool.Free(m_block_start);
 }
 
-Status DataWriter::Create(const char* bucket_path, fileid_t fileid)
+Status DataWriter::Create(const char* bucket_path, fileid_t fileid, uint64_t expected_size, bool bypass_cache)
 {
 	StrCpy(m_bucket_path, sizeof(m_bucket_path), bucket_path);
 	m_segment_fileid = fileid;
@@ -110,10 +132,36 @@ Status DataWriter::Create(const char* bucket_path, fileid_t fileid)
 	{
 		return ERR_FILE_WRITE;
 	}
+	m_bypass_cache = bypass_cache;
+	m_async_writer.Start(m_offset, expected_size, Engine::GetEngine()->GetConfig().bytes_per_sync, bypass_cache ? file_path : nullptr);
 	
 	return OK;
 }
 
+void DataWriter::Create()
+{
+	m_single_file = true;
+}
+
+void DataWriter::AddStat(const Object& obj)
+{
+	switch(obj.type)
+	{
+	case SetType:
+		m_stat.set_stat.Add(obj.key.size, obj.value.size);
+		break;
+	case DeleteType:
+		m_stat.delete_stat.Add(obj.key.size, obj.value.size);
+		break;
+	case AppendType:
+		m_stat.append_stat.Add(obj.key.size, obj.value.size);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
 StrView DataWriter::ClonePrevKey(const StrView& str)
 {
 	m_prev_key.Assign(str.data, str.size);
@@ -161,6 +209,8 @@ Status DataWriter::WriteGroup(IteratorImpl& iter, L0GroupIndex& gi)
 
 		m_block_ptr = EncodeString(m_block_ptr, value.data, value.size);
 
+		AddStat(obj);
+
 		//key可能是临时的key，需要clone下
 		prev_key = ClonePrevKey(key);
 		iter.Next();
@@ -292,7 +342,7 @@ Status DataWriter::Write(IteratorImpl& iter)
 		
 		SegmentL0Index L0_index;
 		L0_index.start_key = CloneKey(m_key_buf, iter.object().key);	//iter.Key可能是临时key
-		L0_index.L0offset = m_offset;
+		L0_index.L0offset = m_single_file ? m_index_writer.Offset() : m_offset;
 		
 		uint32_t index_size;
 		WriteBlock(iter, index_size);
@@ -304,14 +354,27 @@ Status DataWriter::Write(IteratorImpl& iter)
 		L0_index.L0origin_size = block_size;
 		L0_index.L0index_size = index_size;
 		
-		//写block
-		if(m_file.Write(m_block_start, block_size) != block_size)
+		//提交给io线程写block，换一个新块继续编码
+		byte_t* block = m_block_start;
+		m_block_start = m_large_block_pool.Alloc();
+		m_block_end = m_block_start + m_large_block_pool.BlockSize();
+		if(m_single_file)
+		{
+			Status s = m_index_writer.WriteDataBlock(block, block_size);
+			if(s != OK)
+			{
+				return s;
+			}
+		}
+		else
 		{
-			return ERR_FILE_WRITE;
+			if(!m_async_writer.Write(block, block_size))
+			{
+				return ERR_FILE_WRITE;
+			}
+			m_offset += block_size;
 		}
 		m_index_writer.Write(L0_index, m_key_hashs);
-		
-		m_offset += block_size;
 	}
 
 	return OK;	
@@ -319,13 +382,27 @@ Status DataWriter::Write(IteratorImpl& iter)
 
 Status DataWriter::Finish()
 {
+	//单文件segment由index writer完成刷盘
+	if(m_single_file)
+	{
+		return OK;
+	}
+	if(!m_async_writer.Finish())
+	{
+		return ERR_FILE_WRITE;
+	}
     if(m_bucket_conf.sync_data)
     {
-        if(!m_file.Sync())
+        if(!m_file.DataSync())
         {
             return ERR_FILE_WRITE;
         }
     }
+	if(m_bypass_cache)
+	{
+		//丢弃未用O_DIRECT写入的首尾部分，未刷盘的脏页会被忽略
+		m_file.DropCache(0, 0);
+	}
 	return OK;
 }
 
@@ -25,10 +25,14 @@ limitations under the License.
 #include "file.h"
 #include "iterator_impl.h"
 #include "path.h"
+#include "rate_limiter.h"
+#include "async_file.h"
 
 namespace xfdb 
 {
 
+class IndexReader;
+
 class DataReader
 {
 public:
@@ -37,15 +41,21 @@ public:
 	
 public:	
 	Status Open(const char* bucket_path, fileid_t fileid);
+	/**单文件segment，与index_reader共用文件和映射区*/
+	void Open(const IndexReader& index_reader);
 	Status Search(const SegmentL0Index& L0_index, const StrView& key, ObjectType& type, std::string& value) const;
 
 private:
-	File m_file;
-	std::string m_path;
+	const File* m_file;				//指向m_data_file或index reader的文件
+	const FileMapping* m_mapping;	//mmap_read时有效
+	File m_data_file;
+	FileMapping m_data_mapping;
+	std::string m_cache_key_prefix;
 	BlockPool& m_large_block_pool;
 
 private:
 	friend class SegmentReaderIterator;	
+	friend class DataBlockReader;
 	DataReader(const DataReader&) = delete;
 	DataReader& operator=(const DataReader&) = delete;
 };
@@ -58,12 +68,14 @@ public:
 	~DataWriter();
 	
 public:	
-	Status Create(const char* bucket_path, fileid_t fileid);
+	Status Create(const char* bucket_path, fileid_t fileid, uint64_t expected_size = 0, bool bypass_cache = false);
+	/**单文件segment，data块通过index writer写入其文件中，index writer需已以single_file方式Create*/
+	void Create();
 	Status Write(IteratorImpl& iter);
 	Status Finish();
 	inline uint64_t FileSize()
 	{
-		return m_file.Size();
+		return m_single_file ? 0 : m_file.Size();
 	}
 		
 	static Status Remove(const char* bucket_path, fileid_t fileid);
@@ -76,17 +88,22 @@ private:
 	Status WriteL2GroupIndex(const LnGroupIndex* group_indexs, int index_cnt);
 	
 	StrView ClonePrevKey(const StrView& str);
+	void AddStat(const Object& obj);
 
 private:
 	const BucketConfig& m_bucket_conf;
 	IndexWriter& m_index_writer;
 	BlockPool& m_large_block_pool;
+	RateLimiter& m_rate_limiter;
 
 	char m_bucket_path[MAX_PATH_LEN];
 	fileid_t m_segment_fileid;
 	
 	File m_file;
+	AsyncFileWriter m_async_writer;		//编码与写文件并行
 	uint64_t m_offset;
+	bool m_bypass_cache;
+	bool m_single_file;
 
 	byte_t* m_block_start;
 	byte_t* m_block_end;
@@ -97,7 +114,7 @@ private:
 	
 	std::deque<uint32_t> m_key_hashs;
 
-	ObjectStat m_stat;
+	ObjectStat m_stat;		//实际写入的object统计
 	
 private:
 	friend class SegmentWriter;
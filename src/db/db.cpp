@@ -55,6 +55,10 @@ bool GlobalConfig::Check() const
     {
         return false;
     }
+    if(force_merge_deleted_percent > 100 || bottom_rewrite_garbage_percent > 100)
+    {
+        return false;
+    }
     return true;
 }
 
@@ -64,11 +68,27 @@ bool BucketConfig::Check() const
     {
         return false;
     }
+    if(compaction_style == COMPACTION_FIFO && fifo_max_size == 0 && fifo_ttl_s == 0)
+    {
+        return false;
+    }
     return true;
 }
 
 bool DBConfig::Check() const
 {
+	//目录序号在bucket meta中占1字节，0表示db目录
+	if(data_paths.size() >= 0xFF)
+	{
+		return false;
+	}
+	for(const auto& dp : data_paths)
+	{
+		if(dp.path.empty() || dp.path.back() == '/' || dp.min_level > dp.max_level)
+		{
+			return false;
+		}
+	}
     return true;
 }
 
@@ -107,7 +127,7 @@ Status DB::Open(const DBConfig& dbconf, const std::string& db_path, DBPtr& db)
     return s;
 }
 
-Status DB::Remove(const std::string& db_path)
+Status DB::Remove(const std::string& db_path, const DBConfig& dbconf)
 {
 	if(db_path.empty() || db_path.back() == '/')
 	{
@@ -118,7 +138,7 @@ Status DB::Remove(const std::string& db_path)
 	{
 		return ERR_STOPPED;
 	}
-	return engine->RemoveDB(db_path);
+	return engine->RemoveDB(db_path, dbconf);
 }
 
 const std::string& DB::GetPath()
@@ -224,10 +244,26 @@ Status DB::Merge(const std::string& bucket_name)
 	return m_db->Merge(bucket_name);
 }
 
-Status DB::Backup(const std::string& backup_dir)
+Status DB::Merge(const std::string& bucket_name, const StrView& start_key, const StrView& end_key)
+{
+	assert(m_db);
+	if(end_key.size != 0 && start_key.Compare(end_key) >= 0)
+	{
+		return ERROR;
+	}
+	return m_db->Merge(bucket_name, start_key, end_key);
+}
+
+Status DB::Backup(const std::string& backup_dir, bool incremental)
+{
+	assert(m_db);
+	return m_db->Backup(backup_dir, incremental ? BACKUP_INCREMENTAL : BACKUP_FULL);
+}
+
+Status DB::Checkpoint(const std::string& checkpoint_dir)
 {
 	assert(m_db);
-	return m_db->Backup(backup_dir);
+	return m_db->Backup(checkpoint_dir, BACKUP_CHECKPOINT);
 }
 
 }   
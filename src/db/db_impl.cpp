@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ***************************************************************************/
 
+#include <set>
 #include "db_impl.h"
 #include "db_types.h"
 #include "bucket.h"
@@ -23,6 +24,9 @@ limitations under the License.
 #include "file_util.h"
 #include "directory.h"
 #include "lock_file.h"
+#include "rate_limiter.h"
+#include "thread.h"
+#include "engine.h"
 
 
 namespace xfdb 
@@ -107,7 +111,7 @@ void DBImpl::OpenBucket(const DBMeta& dm, const BucketSet* last_bucket_set, std:
 	assert(last_bucket_set != nullptr);
 	const auto& last_buckets = last_bucket_set->Buckets();
 	
-	BucketPtr bptr;
+	std::vector<const BucketInfo*> bucket_infos;
 	for(const auto& bi : dm.alive_buckets)
 	{
 		auto it = last_buckets.find(bi.name);
@@ -115,21 +119,43 @@ void DBImpl::OpenBucket(const DBMeta& dm, const BucketSet* last_bucket_set, std:
 		{
 			buckets[bi.name] = it->second;
 		}
-		else if(OpenBucket(bi, bptr) == OK)
+		else
 		{
-			buckets[bi.name] = bptr;
+			bucket_infos.push_back(&bi);
 		}
 	}
+	OpenBucket(bucket_infos, buckets);
 }
 
 void DBImpl::OpenBucket(const DBMeta& dm, std::map<std::string, BucketPtr>& buckets)
 {	
-	BucketPtr bptr;
+	std::vector<const BucketInfo*> bucket_infos;
+	bucket_infos.reserve(dm.alive_buckets.size());
 	for(const auto& bi : dm.alive_buckets)
 	{
-		if(OpenBucket(bi, bptr) == OK)
+		bucket_infos.push_back(&bi);
+	}
+	OpenBucket(bucket_infos, buckets);
+}
+
+void DBImpl::OpenBucket(const std::vector<const BucketInfo*>& bucket_infos, std::map<std::string, BucketPtr>& buckets)
+{
+	std::vector<BucketPtr> bptrs(bucket_infos.size());
+
+	ParallelFor(bucket_infos.size(), Engine::GetEngine()->GetConfig().open_thread_num, [&](size_t i)
+	{
+		BucketPtr bptr;
+		if(OpenBucket(*bucket_infos[i], bptr) == OK)
 		{
-			buckets[bi.name] = bptr;
+			bptrs[i] = bptr;
+		}
+	});
+
+	for(size_t i = 0; i < bucket_infos.size(); ++i)
+	{
+		if(bptrs[i])
+		{
+			buckets[bucket_infos[i]->name] = bptrs[i];
 		}
 	}
 }
@@ -196,10 +222,9 @@ Status DBImpl::OpenBucket(const char* dbmeta_filename, const DBMeta& dm)
 	return OK;
 }
 
-Status DBImpl::BackupDBMeta(BucketSetPtr& bucket_set, const std::string& backup_db_dir)
+Status DBImpl::BackupDBMeta(BucketSetPtr& bucket_set, const std::string& backup_db_dir, fileid_t& dbmeta_fileid)
 {
 	DBMeta dm;
-	fileid_t dbmeta_fileid;
 
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
@@ -230,7 +255,43 @@ Status DBImpl::BackupDBMeta(BucketSetPtr& bucket_set, const std::string& backup_
 	return s;
 }
 
-Status DBImpl::Backup(const std::string& backup_dir)
+void DBImpl::RemoveStaleBackup(BucketSetPtr& bucket_set, const std::string& backup_db_dir, fileid_t dbmeta_fileid)
+{
+	char path[MAX_PATH_LEN];
+
+	std::vector<FileName> names;
+	ListDBMetaFile(backup_db_dir.c_str(), names);
+	for(const auto& name : names)
+	{
+		if(strtoull(name.str, nullptr, 10) != dbmeta_fileid)
+		{
+			Path::Combine(path, sizeof(path), backup_db_dir.c_str(), name.str);
+			File::Remove(path);
+		}
+	}
+
+	//bucket目录名为name.id，不在当前bucket集合中的目录是已删除的bucket
+	std::set<std::string> bucket_dirs;
+	const auto& buckets = bucket_set->Buckets();
+	for(auto it = buckets.begin(); it != buckets.end(); ++it)
+	{
+		MakeBucketPath(backup_db_dir.c_str(), it->second->Info().name.c_str(), it->second->Info().id, path);
+		bucket_dirs.insert(Path::GetFileName(path));
+	}
+
+	names.clear();
+	ListFile(backup_db_dir.c_str(), "*.*", names);
+	for(const auto& name : names)
+	{
+		Path::Combine(path, sizeof(path), backup_db_dir.c_str(), name.str);
+		if(bucket_dirs.find(name.str) == bucket_dirs.end() && xfutil::Directory::Exist(path))
+		{
+			xfutil::Directory::Remove(path);
+		}
+	}
+}
+
+Status DBImpl::Backup(const std::string& backup_dir, BackupType type)
 {
     if(!xfutil::Directory::Exist(backup_dir.c_str()))
     {
@@ -241,7 +302,8 @@ Status DBImpl::Backup(const std::string& backup_dir)
     backup_db_dir.append("/");
     backup_db_dir.append(Path::GetFileName(m_path.c_str()));
 
-    if(xfutil::Directory::Exist(backup_db_dir.c_str()))
+    //增量备份时目标目录可以是上次的备份
+    if(type != BACKUP_INCREMENTAL && xfutil::Directory::Exist(backup_db_dir.c_str()))
     {
         return ERR_PATH_EXIST;
     }
@@ -260,21 +322,29 @@ Status DBImpl::Backup(const std::string& backup_dir)
         return OK;
     }
 
+    //backup的io优先级最低
+    IOPriorityGuard io_guard(IO_PRIORITY_LOW);
+
     //对每个bucket进行backup，然后再写dbmeta
     const auto& buckets = bucket_set->Buckets();
     for(auto it = buckets.begin(); it != buckets.end(); ++it)
     {
-        Status s = it->second->Backup(backup_db_dir);
+        Status s = it->second->Backup(backup_db_dir, type);
         if(s != OK)
         {
             return s;
         }
     }
-    Status s = BackupDBMeta(bucket_set, backup_db_dir);
+    fileid_t dbmeta_fileid;
+    Status s = BackupDBMeta(bucket_set, backup_db_dir, dbmeta_fileid);
     if(s != OK)
     {
         return s;
     }
+    if(type == BACKUP_INCREMENTAL)
+    {
+        RemoveStaleBackup(bucket_set, backup_db_dir, dbmeta_fileid);
+    }
 
     if(!LockFile::Create(backup_db_dir))
     {
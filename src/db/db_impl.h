@@ -92,6 +92,10 @@ public:
 	{
 		return ERR_INVALID_MODE;
 	}
+	virtual Status Merge(const std::string& bucket_name, const StrView& start_key, const StrView& end_key)
+	{
+		return ERR_INVALID_MODE;
+	}
     
     //获取迭代器
     virtual Status NewIterator(const std::string& bucket_name, IteratorImplPtr& iter)
@@ -99,8 +103,8 @@ public:
 		return ERR_INVALID_MODE;
     }
 
-    //全量备份
-    Status Backup(const std::string& backup_dir);
+    //备份或创建检查点
+    Status Backup(const std::string& backup_dir, BackupType type);
     
 public:
 	inline const std::string& GetPath() const
@@ -119,13 +123,17 @@ protected:
 
 	void OpenBucket(const DBMeta& dm, const BucketSet* last_bucket_set, std::map<std::string, BucketPtr>& buckets);
 	void OpenBucket(const DBMeta& dm, std::map<std::string, BucketPtr>& buckets);
+	//用open_thread_num个线程并行打开
+	void OpenBucket(const std::vector<const BucketInfo*>& bucket_infos, std::map<std::string, BucketPtr>& buckets);
 
 	Status OpenBucket(const BucketInfo& bi, BucketPtr& bptr);
 	bool GetBucket(const std::string& bucket_name, BucketPtr& ptr) const;
 
 	virtual BucketPtr NewBucket(const BucketInfo& bucket_info) = 0;
 
-    Status BackupDBMeta(BucketSetPtr& bucket_set, const std::string& backup_db_dir);
+    Status BackupDBMeta(BucketSetPtr& bucket_set, const std::string& backup_db_dir, fileid_t& dbmeta_fileid);
+    //增量备份后删除目标中旧的db meta文件和已删除bucket的目录
+    void RemoveStaleBackup(BucketSetPtr& bucket_set, const std::string& backup_db_dir, fileid_t dbmeta_fileid);
 
 protected:
 	const DBConfig m_conf;
@@ -48,6 +48,8 @@ typedef uint64_t objectid_t;
 #define MAX_LEVEL_ID				15                  //part合并限制的最大level
 #define MAX_MERGE_COUNT             MERGE_COUNT_MASK    //full合并限制的最大次数
 
+#define MIN_FORCE_MERGE_DELETED_NUM	1024				//删除对象数不少于此值时才会强制合并
+
 static inline uint8_t GetLevelID(uint16_t merge_count)
 {
     return (merge_count >= MAX_LEVEL_ID) ? MAX_LEVEL_ID : merge_count;
@@ -58,11 +60,32 @@ static inline uint8_t GetLevelID(uint16_t merge_count)
 #define MAX_SEGMENT_ID				((0x1ULL << (64-SEGMENT_ID_SHIFT)) - 1)
 #define SEGMENT_FILEID(id, count)	(((id) << SEGMENT_ID_SHIFT) | count)
 
+//新segment从SLOT_SEGMENT_ID_BASE开始按槽分配segment id，每个槽有SEGMENT_SLOT_SIZE个id；
+//槽内同时只有一个segment，单独重写时segment id在槽内加1且merge count不变，因此重写不消耗merge次数，且仍排在更新的segment之前
+//旧版本按1递增分配的segment id都小于SLOT_SEGMENT_ID_BASE，重写时只能增加merge count
+#define SEGMENT_SLOT_BITNUM			20
+#define SEGMENT_SLOT_SIZE			(0x1ULL << SEGMENT_SLOT_BITNUM)
+#define SLOT_SEGMENT_ID_BASE		(0x1ULL << (63-SEGMENT_ID_SHIFT))
+
+#define BOTTOM_REWRITE_SAMPLE_NUM	128				//估算不参与merge的segment的垃圾占比时抽样的key数
+
 #define INVALID_FILE_ID				0
 #define MIN_FILE_ID					(INVALID_FILE_ID + 1)
 #define MAX_FILE_ID					(fileid_t(-1) - 1)
 static_assert(MIN_FILE_ID > 0, "invalid MIN_FILE_ID");
 
+//单独重写fileid对应的segment时新的fileid，无法重写时返回INVALID_FILE_ID
+static inline fileid_t RewriteSegmentFileID(fileid_t fileid)
+{
+	fileid_t segment_id = SEGMENT_ID(fileid);
+	if(segment_id >= SLOT_SEGMENT_ID_BASE && ((segment_id + 1) & (SEGMENT_SLOT_SIZE - 1)) != 0)
+	{
+		return SEGMENT_FILEID(segment_id + 1, MERGE_COUNT(fileid));
+	}
+	//旧版本的segment或槽已用完时增加merge count
+	return (MERGE_COUNT(fileid) < MAX_MERGE_COUNT) ? fileid + 1 : INVALID_FILE_ID;
+}
+
 #define INVALID_OBJECT_ID			0
 #define MIN_OBJECT_ID				(INVALID_OBJECT_ID + 1)
 #define MAX_OBJECT_ID				(objectid_t(-1) - 1)		//64bit
@@ -102,7 +125,7 @@ static_assert(MAX_VALUE_SIZE <= 64*1024, "invalid MAX_VALUE_SIZE");			//待支
 //NOTE:值必须小于16
 enum ObjectType : uint8_t
 {
-	DeleteType = 0, 	//直到最终的level后才会消除
+	DeleteType = 0, 	//直到合并到最底层后才会消除
 						//如果value长度不为0，则是计数值，
 						//value是剩余消除key的计数，为0时该delete记录也消除
 	SetType = 1,
@@ -253,12 +276,31 @@ struct SegmentMeta
     }
 };
 
+enum BackupType : uint8_t
+{
+	BACKUP_FULL = 0,		//拷贝所有segment文件，目标目录不能已存在
+	BACKUP_INCREMENTAL,		//只拷贝目标中没有的segment文件，再删除目标中不再使用的文件
+	BACKUP_CHECKPOINT,		//硬链接segment文件，不在同一文件系统时拷贝，目标目录不能已存在
+};
+
 struct SegmentStat
 {
 	fileid_t segment_fileid;	//segment fileid
-	uint64_t data_filesize;		//data文件大小
+	uint64_t data_filesize;		//data文件大小，单文件segment时为0
 	uint64_t index_filesize;	//index文件大小
 	uint32_t L2index_meta_size;	//L2层索引+meta大小，包含2*4Byte
+
+	//与index文件的meta相同，用于不打开segment时判断key范围；旧的bucket meta中没有，此时max_key为空
+	std::string min_key;
+	std::string max_key;
+	objectid_t max_object_id = MIN_OBJECT_ID;
+	fileid_t max_merge_segment_id = MIN_FILE_ID;
+
+	//与index文件meta中的object统计相同，用于不打开segment时计算合并分数和删除占比；旧的bucket meta中没有，此时全为0
+	ObjectStat object_stat = ObjectStat();
+
+	//segment文件所在目录：0为bucket目录，i为DBConfig::data_paths[i-1]下的bucket目录
+	uint8_t path_id = 0;
 };
 
 #define MAX_OBJECT_NUM_OF_GROUP		(8)
@@ -379,6 +421,10 @@ class SegmentReader;
 typedef std::shared_ptr<SegmentReader> SegmentReaderPtr;
 #define NewSegmentReader 	std::make_shared<SegmentReader>
 
+struct SegmentTable;
+typedef std::shared_ptr<SegmentTable> SegmentTablePtr;
+#define NewSegmentTable 	std::make_shared<SegmentTable>
+
 class SegmentReaderIterator;
 typedef std::shared_ptr<SegmentReaderIterator> SegmentReaderIteratorPtr;
 #define NewSegmentReaderIterator 	std::make_shared<SegmentReaderIterator>
@@ -391,6 +437,18 @@ class IteratorSet;
 typedef std::shared_ptr<IteratorSet> IteratorSetPtr;
 #define NewIteratorSet 	std::make_shared<IteratorSet>
 
+class DeleteFilterIterator;
+typedef std::shared_ptr<DeleteFilterIterator> DeleteFilterIteratorPtr;
+#define NewDeleteFilterIterator 	std::make_shared<DeleteFilterIterator>
+
+class ShadowFilterIterator;
+typedef std::shared_ptr<ShadowFilterIterator> ShadowFilterIteratorPtr;
+#define NewShadowFilterIterator 	std::make_shared<ShadowFilterIterator>
+
+class CompactionFilterIterator;
+typedef std::shared_ptr<CompactionFilterIterator> CompactionFilterIteratorPtr;
+#define NewCompactionFilterIterator 	std::make_shared<CompactionFilterIterator>
+
 class WriteOnlyObjectWriterIterator;
 typedef std::shared_ptr<WriteOnlyObjectWriterIterator> WriteOnlyObjectWriterIteratorPtr;
 #define NewWriteOnlyObjectWriterIterator 	std::make_shared<WriteOnlyObjectWriterIterator>
@@ -414,7 +472,11 @@ public:
 	void GetMergingReaders(std::map<fileid_t, ObjectReaderPtr>& segment_readers) const;
 	uint64_t GetMergingSize() const;
 
+	//合并或重写后的fileid，无法产生时返回INVALID_FILE_ID
 	fileid_t NewSegmentFileID() const;
+
+	//是否合并到了最底层，即比合并segment更老的segment都参与了合并，此时可消除删除标记
+	bool IsBottomMerge() const;
 };
 
 
@@ -200,7 +200,7 @@ uint32_t DBMetaFile::EstimateSize(const DBMeta& dm)
 			
 }
 
-Status DBMetaFile::Remove(const char* db_path, const char* file_name)
+Status DBMetaFile::Remove(const char* db_path, const char* file_name, const std::vector<DataPath>& data_paths)
 {
 	DBMeta dm;
 	Status s = DBMetaFile::Read(db_path, file_name, dm);
@@ -210,17 +210,18 @@ Status DBMetaFile::Remove(const char* db_path, const char* file_name)
 		return s;
 	}
 
-	char path[MAX_PATH_LEN];
+	std::vector<std::string> segment_paths;
 	for(const auto& bi : dm.deleted_buckets)
 	{
-		MakeBucketPath(db_path, bi.name.c_str(), bi.id, path);
-		s = WriteOnlyBucket::Remove(path);
+		MakeSegmentPaths(db_path, data_paths, bi.name.c_str(), bi.id, segment_paths);
+		s = WriteOnlyBucket::Remove(segment_paths);
 		if(s != OK)
 		{
 			assert(s != ERR_FILE_READ);
 			return s;
 		}
 	}
+	char path[MAX_PATH_LEN];
 	MakeDBMetaFilePath(db_path, file_name, path);
 	return File::Remove(path) ? OK : ERR_PATH_DELETE;
 }
@@ -39,7 +39,8 @@ public:
 	static Status Read(const char* db_path, const char* file_name, DBMeta& dm);
 	static Status Write(const char* db_path, const char* file_name, DBMeta& dm);
 	
-	static Status Remove(const char* db_path, const char* file_name);
+	//删除meta中已删除的bucket，data_paths见DBConfig
+	static Status Remove(const char* db_path, const char* file_name, const std::vector<DataPath>& data_paths);
 	
 private:
 	static Status Parse(const byte_t* data, uint32_t size, DBMeta& dm);
@@ -45,6 +45,44 @@ Status Start(const GlobalConfig& gconf)
 	return s_engine_wrapper.Start(gconf);
 }
 
+Status GetMergeQueueStat(MergeQueueStat& stat)
+{
+	EnginePtr engine = Engine::GetEngine();
+	if(!engine)
+	{
+		return ERR_STOPPED;
+	}
+	return engine->GetMergeQueueStat(stat);
+}
+
+Status GetMemoryStat(MemoryStat& stat)
+{
+	EnginePtr engine = Engine::GetEngine();
+	if(!engine)
+	{
+		return ERR_STOPPED;
+	}
+	engine->GetMemoryStat(stat);
+	return OK;
+}
+
+static void GetBlockPoolStat(BlockPool& pool, BlockPoolStat& stat)
+{
+	stat.block_size = pool.BlockSize();
+	stat.cache_num = pool.CacheNum();
+	stat.free_num = pool.FreeNum();
+	stat.exhausted_num = pool.ExhaustedNum();
+	stat.overflow_num = pool.OverflowNum();
+	stat.memory_size = pool.MemorySize();
+	stat.huge_page = pool.HugePage();
+}
+
+void Engine::GetMemoryStat(MemoryStat& stat)
+{
+	GetBlockPoolStat(m_large_block_pool, stat.large_block_pool);
+	GetBlockPoolStat(m_small_block_pool, stat.small_block_pool);
+}
+
 EngineWrapper::~EngineWrapper()
 {
     if(m_engine)
@@ -106,8 +144,11 @@ Status Engine::Start()
     srand(time(nullptr));
 
 	uint64_t cache_num = (m_conf.write_cache_size+LARGE_BLOCK_SIZE-1) / LARGE_BLOCK_SIZE;
-	m_large_block_pool.Init(LARGE_BLOCK_SIZE, cache_num);
-	m_small_block_pool.Init(SMALL_BLOCK_SIZE, cache_num);
+	m_large_block_pool.Init(LARGE_BLOCK_SIZE, cache_num, m_conf.use_huge_page);
+	m_small_block_pool.Init(SMALL_BLOCK_SIZE, cache_num, m_conf.use_huge_page);
+	m_rate_limiter.Init(m_conf.io_rate_limit, m_conf.io_rate_auto_tune);
+	//只读进程不写segment
+	m_async_write_pool.Start((m_conf.mode & MODE_WRITEONLY) ? m_conf.write_io_thread_num : 0);
 
 	Status s = Start_();
     m_started = (s == OK);
@@ -125,6 +166,7 @@ void Engine::Stop()
 	CloseAllDB();
 
     Stop_();
+	m_async_write_pool.Stop();
 
     if(!m_conf.log_file_path.empty())
     {
@@ -25,6 +25,9 @@ limitations under the License.
 #include "file_util.h"
 #include "block_pool.h"
 #include "lru_cache.h"
+#include "block_cache.h"
+#include "rate_limiter.h"
+#include "async_file.h"
 
 namespace xfdb 
 {
@@ -36,7 +39,8 @@ public:
 		: m_conf(conf), 
 		  m_bloom_filter_cache(conf.bloom_filter_cache_size),
 	   	  m_index_cache(conf.index_cache_size), 
-		  m_data_cache(conf.data_cache_size)
+		  m_data_cache(conf.data_cache_size),
+		  m_table_cache(conf.max_open_files)
 	{
 		m_started = false;
 	}
@@ -59,18 +63,30 @@ public:
 	{
 		return m_small_block_pool;
 	}	
-	inline LruCache<std::string, std::string>& GetBloomFilterCache()
+	inline BlockCache& GetBloomFilterCache()
 	{
 		return m_bloom_filter_cache;
 	}	
-	inline LruCache<std::string, std::string>& GetIndexCache()
+	inline BlockCache& GetIndexCache()
 	{
 		return m_index_cache;
 	}	
-	inline LruCache<std::string, std::string>& GetDataCache()
+	inline BlockCache& GetDataCache()
 	{
 		return m_data_cache;
 	}	
+	inline LruCache<const SegmentReader*, SegmentTablePtr>& GetTableCache()
+	{
+		return m_table_cache;
+	}
+	inline RateLimiter& GetRateLimiter()
+	{
+		return m_rate_limiter;
+	}
+	inline AsyncWritePool& GetAsyncWritePool()
+	{
+		return m_async_write_pool;
+	}
 public:	
 	Status Start();
 	void Stop();
@@ -78,11 +94,18 @@ public:
 	Status OpenDB(const DBConfig& conf, const std::string& db_path, DBImplPtr& dbptr);
 	void CloseDB(DBImplPtr& db);
 	
-	virtual Status RemoveDB(const std::string& db_path)
+	virtual Status RemoveDB(const std::string& db_path, const DBConfig& dbconf)
 	{
 		return ERR_INVALID_MODE;
 	}
 
+	virtual Status GetMergeQueueStat(MergeQueueStat& stat)
+	{
+		return ERR_INVALID_MODE;
+	}
+
+	void GetMemoryStat(MemoryStat& stat);
+
 protected:
 	virtual Status Start_() = 0;
 	virtual void Stop_() = 0;
@@ -103,9 +126,13 @@ protected:
 	BlockPool m_large_block_pool;
 	BlockPool m_small_block_pool;
 
-	LruCache<std::string, std::string> m_bloom_filter_cache;
-	LruCache<std::string, std::string> m_index_cache;
-	LruCache<std::string, std::string> m_data_cache;
+	BlockCache m_bloom_filter_cache;
+	BlockCache m_index_cache;
+	BlockCache m_data_cache;
+	LruCache<const SegmentReader*, SegmentTablePtr> m_table_cache;		//key: segment reader，大小为打开的文件数
+
+	RateLimiter m_rate_limiter;
+	AsyncWritePool m_async_write_pool;
 
 	mutable std::mutex m_db_mutex;
 	std::map<std::string, DBImplWptr> m_dbs;	//key: db path
@@ -55,6 +55,39 @@ bool CheckBucketName(const std::string& bucket_name)
 	return true;
 }
 
+void MakeSegmentPaths(const char* db_path, const std::vector<DataPath>& data_paths, const char* bucket_name, bucketid_t bucket_id, std::vector<std::string>& segment_paths)
+{
+	const char* db_name = Path::GetFileName(db_path);
+
+	char path[MAX_PATH_LEN];
+	segment_paths.resize(data_paths.size() + 1);
+
+	MakeBucketPath(db_path, bucket_name, bucket_id, path);
+	segment_paths[0] = path;
+	for(size_t i = 0; i < data_paths.size(); ++i)
+	{
+		snprintf(path, sizeof(path), "%s/%s/%s.%u", data_paths[i].path.c_str(), db_name, bucket_name, bucket_id);
+		segment_paths[i+1] = path;
+	}
+}
+
+bool CreateSegmentPaths(const char* db_path, const std::vector<DataPath>& data_paths, const std::vector<std::string>& segment_paths)
+{
+	assert(segment_paths.size() == data_paths.size() + 1);
+	const char* db_name = Path::GetFileName(db_path);
+
+	char path[MAX_PATH_LEN];
+	for(size_t i = 0; i < data_paths.size(); ++i)
+	{
+		Path::Combine(path, sizeof(path), data_paths[i].path.c_str(), db_name);
+		if(!Directory::Create(path) || !Directory::Create(segment_paths[i+1].c_str()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 int ListFileCallback(const char* dirname, const char* filename, void* arg)
 {
 	std::vector<FileName>* names = (std::vector<FileName>*)arg;
@@ -160,6 +193,10 @@ bool ParseHeader(const byte_t* &data, size_t size, const char expect_magic[FILE_
 
 	const byte_t* ptr = data + FILE_VERSION_OFF;
 	header.version = Decode16(ptr);
+	if(header.version > max_version)
+	{
+		return false;
+	}
 	header.create_time_s = Decode64(ptr);
 
 	data += FILE_HEAD_SIZE;
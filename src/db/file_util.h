@@ -20,6 +20,7 @@ limitations under the License.
 #include "db_types.h"
 #include "path.h"
 #include "buffer.h"
+#include "file.h"
 
 namespace xfutil
 {
@@ -29,22 +30,26 @@ namespace xfdb
 {
 
 #define DB_META_FILE_VERSION		1
-#define BUCKET_META_FILE_VERSION	1
-#define INDEX_FILE_VERSION			1
+#define BUCKET_META_FILE_VERSION	2	//2: 增加增量文件
+#define INDEX_FILE_VERSION			2	//2: 单文件segment，data块、L1 index块与L2 index/meta写在同一个index文件中
+#define SEPARATE_INDEX_FILE_VERSION	1	//1: index与data分为两个文件
 #define DATA_FILE_VERSION			1
 #define NOTIFY_FILE_VERSION			1
+#define NOTIFY_RING_FILE_VERSION	1
 
 #define DB_META_FILE_MAGIC			"DMTA"
 #define BUCKET_META_FILE_MAGIC 		"BMTA"
 #define INDEX_FILE_MAGIC			"INDX"
 #define DATA_FILE_MAGIC				"DATA"
 #define NOTIFY_FILE_MAGIC			"MSG "
+#define NOTIFY_RING_FILE_MAGIC		"RING"
 
 #define DB_META_FILE_EXT			".dmeta"
 #define BUCKET_META_FILE_EXT 		".bmeta"
 #define INDEX_FILE_EXT				".index"
 #define DATA_FILE_EXT				".data"
 #define NOTIFY_FILE_EXT				".msg"
+#define NOTIFY_RING_FILE_NAME		"notify.ring"
 
 //有效属性ID从2开始
 enum
@@ -78,6 +83,11 @@ static inline void MakeBucketPath(const char* db_path, const char* bucket_name,
 	snprintf(path, MAX_PATH_LEN, "%s/%s.%u", db_path, bucket_name, bucket_id);
 }
 
+//bucket的segment目录：[0]为db目录下的bucket目录，[i]为DBConfig::data_paths[i-1]下的<db目录名>/<bucket目录名>
+void MakeSegmentPaths(const char* db_path, const std::vector<DataPath>& data_paths, const char* bucket_name, bucketid_t bucket_id, std::vector<std::string>& segment_paths);
+//在data_paths下创建db和bucket目录
+bool CreateSegmentPaths(const char* db_path, const std::vector<DataPath>& data_paths, const std::vector<std::string>& segment_paths);
+
 static inline void MakeDBMetaFileName(fileid_t seqid, char name[MAX_FILENAME_LEN])
 {
 	snprintf(name, MAX_FILENAME_LEN, "%lu" DB_META_FILE_EXT, seqid);
@@ -134,6 +144,23 @@ static inline Status ListBucketMetaFile(const char* path, std::vector<FileName>&
 	return ListFile(path, "*" BUCKET_META_FILE_EXT, names, true);
 }
 
+static inline void MakeNotifyRingFilePath(const char* notify_path, char path[MAX_PATH_LEN])
+{
+	snprintf(path, MAX_PATH_LEN, "%s/" NOTIFY_RING_FILE_NAME, notify_path);
+}
+
+//block cache的key前缀：文件路径+inode+修改时间，同一路径的文件被删除重建后不会命中旧块，多进程共享cache时同一文件的前缀相同
+static inline void MakeCacheKeyPrefix(const char* file_path, const File& file, std::string& prefix)
+{
+	prefix = file_path;
+	struct stat st;
+	if(fstat(file.GetFD(), &st) == 0)
+	{
+		prefix.append((char*)&st.st_ino, sizeof(st.st_ino));
+		prefix.append((char*)&st.st_mtim, sizeof(st.st_mtim));
+	}
+}
+
 static inline Status ListNotifyFile(const char* path, std::vector<FileName>& names)
 {
 	return ListFile(path, "*" NOTIFY_FILE_EXT, names);
@@ -160,9 +187,9 @@ static inline bool ParseBucketMetaFileHeader(const byte_t* &data, size_t size, F
 	return ParseHeader(data, size, BUCKET_META_FILE_MAGIC, BUCKET_META_FILE_VERSION, header);
 }
 
-static inline byte_t* WriteIndexFileHeader(byte_t* buf)
+static inline byte_t* WriteIndexFileHeader(byte_t* buf, uint16_t version = INDEX_FILE_VERSION)
 {
-	return WriteHeader(buf, INDEX_FILE_MAGIC, INDEX_FILE_VERSION);
+	return WriteHeader(buf, INDEX_FILE_MAGIC, version);
 }
 static inline bool ParseIndexFileHeader(const byte_t* &data, size_t size, FileHeader& header)
 {
@@ -186,6 +213,15 @@ static inline bool ParseNotifyFileHeader(const byte_t* &data, size_t size, FileH
 	return ParseHeader(data, size, NOTIFY_FILE_MAGIC, NOTIFY_FILE_VERSION, header);
 }
 
+static inline byte_t* WriteNotifyRingFileHeader(byte_t* buf)
+{
+	return WriteHeader(buf, NOTIFY_RING_FILE_MAGIC, NOTIFY_RING_FILE_VERSION);
+}
+static inline bool ParseNotifyRingFileHeader(const byte_t* &data, size_t size, FileHeader& header)
+{
+	return ParseHeader(data, size, NOTIFY_RING_FILE_MAGIC, NOTIFY_RING_FILE_VERSION, header);
+}
+
 Status ReadFile(const char* file_path, String& str);
 Status ReadFile(const File& file, String& str);
 Status ReadFile(const File& file, uint64_t offset, int64_t size, String& str);
@@ -39,14 +39,31 @@ IndexBlockReader::~IndexBlockReader()
 
 Status IndexBlockReader::Read(const SegmentL1Index& L1Index)
 {
-	//读取L1块 cache
-	std::string cache_key = m_index_reader.m_path;
+	m_L1Index_start_key = L1Index.start_key;
+	m_L1Index_size = L1Index.L1index_size;
+
 	uint64_t data_offset = L1Index.L1offset + L1Index.bloom_filter_size;
+	uint32_t data_size = L1Index.L1origin_size - L1Index.bloom_filter_size;
+
+	//文件已映射时直接指向映射区，不经过cache
+	const FileMapping& mapping = m_index_reader.m_mapping;
+	if(mapping.Mapped())
+	{
+		if(data_offset + data_size > mapping.Size())
+		{
+			return ERR_FILE_READ;
+		}
+		m_data.Set((char*)mapping.Data() + data_offset, data_size);
+		return OK;
+	}
+
+	//读取L1块 cache
+	std::string cache_key = m_index_reader.m_cache_key_prefix;
 	cache_key.append((char*)&data_offset, sizeof(data_offset));
 
 	auto& cache = Engine::GetEngine()->GetIndexCache();
-	std::string data;
-	if(!cache.Get(cache_key, data) || data.size() != L1Index.L1origin_size-L1Index.bloom_filter_size)
+	std::string& data = m_buf;
+	if(!cache.Get(cache_key, data) || data.size() != data_size)
 	{
 		std::string bf_data;
 		if(!m_index_reader.Read(&L1Index, bf_data, data))
@@ -56,10 +73,7 @@ Status IndexBlockReader::Read(const SegmentL1Index& L1Index)
 	}
 	
 	assert(!data.empty());
-	m_data = data;
-	m_L1Index_start_key = L1Index.start_key;
-	m_L1Index_size = L1Index.L1index_size;
-
+	m_data.Set(data.data(), data.size());
 	return OK;
 }
 
@@ -70,10 +84,10 @@ Status IndexBlockReader::Search(const StrView& key, SegmentL0Index& L0_index)
 
 Status IndexBlockReader::SearchBlock(const StrView& key, SegmentL0Index& L0_index) const
 {
-	assert(!m_data.empty());
-	const byte_t* block_end = (byte_t*)m_data.data() + m_data.size();
+	assert(!m_data.Empty());
+	const byte_t* block_end = (byte_t*)m_data.data + m_data.size;
 	const byte_t* index_ptr = block_end - m_L1Index_size - sizeof(uint32_t)/*crc32*/;
-	const byte_t* group_ptr = (byte_t*)m_data.data();
+	const byte_t* group_ptr = (byte_t*)m_data.data;
 	
 	//找到第1个大于key的group
 	LnGroupIndex lngroup_index;
@@ -197,10 +211,10 @@ Status IndexBlockReader::SearchGroup(const byte_t* group, uint32_t group_size, c
 
 Status IndexBlockReader::ParseBlock(IndexBlockReaderIteratorPtr& iter_ptr) const
 {
-	assert(!m_data.empty());
-	const byte_t* block_end = (byte_t*)m_data.data() + m_data.size();
+	assert(!m_data.Empty());
+	const byte_t* block_end = (byte_t*)m_data.data + m_data.size;
 	const byte_t* index_ptr = block_end - m_L1Index_size - sizeof(uint32_t)/*crc32*/;
-	const byte_t* group_ptr = (byte_t*)m_data.data();
+	const byte_t* group_ptr = (byte_t*)m_data.data;
 	
 	//找到第1个大于key的group
 	LnGroupIndex lngroup_index;
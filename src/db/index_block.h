@@ -58,7 +58,8 @@ private:
 private:
 	const IndexReader& m_index_reader;
 
-	std::string m_data;
+	std::string m_buf;
+	StrView m_data;			//指向m_buf或文件映射区
 	StrView m_L1Index_start_key;
 	uint32_t m_L1Index_size;
 	
@@ -42,6 +42,7 @@ enum
 
 IndexReader::IndexReader() : m_large_block_pool(Engine::GetEngine()->GetLargeBlockPool()), m_buf(m_large_block_pool)
 {
+	m_version = 0;
 }
 
 IndexReader::~IndexReader()
@@ -57,11 +58,22 @@ Status IndexReader::Open(const char* bucket_path, const SegmentStat& info)
 	{
 		return ERR_FILE_READ;
 	}
-	m_path = index_path;
+	MakeCacheKeyPrefix(index_path, m_file, m_cache_key_prefix);
+
+	if(Engine::GetEngine()->GetConfig().mmap_read)
+	{
+		m_mapping.Map(m_file, MADV_RANDOM);
+	}
+
+	Status s = ReadHeader();
+	if(s != OK)
+	{
+		return s;
+	}
 
 	String str;	
 	uint64_t offset = info.index_filesize - info.L2index_meta_size;
-	Status s = ReadFile(m_file, offset, info.L2index_meta_size, str);
+	s = ReadFile(m_file, offset, info.L2index_meta_size, str);
 	if(s != OK)
 	{
 		return s;
@@ -85,6 +97,25 @@ Status IndexReader::Open(const char* bucket_path, const SegmentStat& info)
 	return OK;
 }
 
+//根据header的版本区分单文件segment与index/data分开的segment
+Status IndexReader::ReadHeader()
+{
+	byte_t buf[FILE_HEAD_SIZE+1];
+	int64_t r_size = m_file.Read(0, buf, sizeof(buf));
+	if(r_size != (int64_t)sizeof(buf))
+	{
+		return ERR_FILE_READ;
+	}
+	const byte_t* ptr = buf;
+	FileHeader header;
+	if(!ParseIndexFileHeader(ptr, r_size, header))
+	{
+		return ERR_FILE_FORMAT;
+	}
+	m_version = header.version;
+	return OK;
+}
+
 bool IndexReader::ParseObjectStat(const byte_t* &data, const byte_t* data_end)
 {
 	uint32_t cnt = DecodeV32(data, data_end);
@@ -119,6 +150,11 @@ bool IndexReader::ParseKeyIndex(const byte_t* &data, const byte_t* data_end, uin
 	StrView key = DecodeString(data, data_end);
 	L1Index.start_key = CloneKey(m_buf, key);
 
+	//单文件segment中L1 index块之间夹着data块，记录与上一块的间隔
+	if(IsSingleFile())
+	{
+		last_offset += DecodeV64(data, data_end);
+	}
 	L1Index.L1offset = last_offset;
 	
 	if(m_meta.bloom_filter_bitnum != 0)
@@ -223,7 +259,11 @@ bool IndexReader::Read(const SegmentL1Index* L1Index, std::string& bf_data, std:
 		buffer = xmalloc(L1Index->L1compress_size);
 	}
 
-	int64_t r_size = m_file.Read(L1Index->L1offset, (void*)buffer, L1Index->L1compress_size);
+	int64_t r_size;
+	{
+		IOReadGuard io_guard(Engine::GetEngine()->GetRateLimiter(), L1Index->L1compress_size);
+		r_size = m_file.Read(L1Index->L1offset, (void*)buffer, L1Index->L1compress_size);
+	}
 	if((uint64_t)r_size != L1Index->L1compress_size)
 	{
 		if(L1Index->L1compress_size <= m_large_block_pool.BlockSize())
@@ -236,11 +276,26 @@ bool IndexReader::Read(const SegmentL1Index* L1Index, std::string& bf_data, std:
 		}
 		return false;
 	}
+	AddCache(L1Index, buffer, bf_data, index_data);
+
+	if(L1Index->L1compress_size <= m_large_block_pool.BlockSize())
+	{
+		m_large_block_pool.Free(buffer);
+	}
+	else
+	{
+		xfree(buffer);
+	}
+	return true;
+}
+
+void IndexReader::AddCache(const SegmentL1Index* L1Index, const byte_t* buffer, std::string& bf_data, std::string& index_data) const
+{
 	//TODO: 解压缩
 
 	if(L1Index->bloom_filter_size != 0)
 	{
-		std::string cache_key = m_path;
+		std::string cache_key = m_cache_key_prefix;
 		cache_key.append((char*)&L1Index->L1offset, sizeof(L1Index->L1offset));
 
 		auto& bf_cache = Engine::GetEngine()->GetBloomFilterCache();
@@ -248,33 +303,31 @@ bool IndexReader::Read(const SegmentL1Index* L1Index, std::string& bf_data, std:
 		bf_cache.Add(cache_key, bf_data, bf_data.size());
 	}
 
-	std::string cache_key = m_path;
-	uint64_t offset = L1Index->L1offset + L1Index->bloom_filter_size;
-	cache_key.append((char*)&offset, sizeof(offset));
-
 	auto& index_cache = Engine::GetEngine()->GetIndexCache();
 	index_data.assign((char*)buffer+L1Index->bloom_filter_size, L1Index->L1origin_size-L1Index->bloom_filter_size);
-	index_cache.Add(cache_key, index_data, index_data.size());
+	index_cache.Add(IndexCacheKey(L1Index), index_data, index_data.size());
+}
 
-	if(L1Index->L1compress_size <= m_large_block_pool.BlockSize())
-	{
-		m_large_block_pool.Free(buffer);
-	}
-	else
-	{
-		xfree(buffer);
-	}
-	return true;
+std::string IndexReader::IndexCacheKey(const SegmentL1Index* L1Index) const
+{
+	std::string cache_key = m_cache_key_prefix;
+	uint64_t offset = L1Index->L1offset + L1Index->bloom_filter_size;
+	cache_key.append((char*)&offset, sizeof(offset));
+	return cache_key;
 }
 
 bool IndexReader::CheckBloomFilter(const SegmentL1Index* L1Index, const StrView& key) const
 {
-	std::string cache_key = m_path;
+	std::string cache_key = m_cache_key_prefix;
 	cache_key.append((char*)&L1Index->L1offset, sizeof(L1Index->L1offset));
 
 	auto& cache = Engine::GetEngine()->GetBloomFilterCache();
 	std::string bf_data;
-	if(!cache.Get(cache_key, bf_data) || bf_data.size() != L1Index->bloom_filter_size)
+	if(m_mapping.Mapped())
+	{
+		bf_data.assign((char*)m_mapping.Data() + L1Index->L1offset, L1Index->bloom_filter_size);
+	}
+	else if(!cache.Get(cache_key, bf_data) || bf_data.size() != L1Index->bloom_filter_size)
 	{
 		std::string index_data;
 		Read(L1Index, bf_data, index_data);
@@ -341,12 +394,53 @@ Status IndexReader::Search(const StrView& key, SegmentL0Index& L0_index) const
 	return block.Search(key, L0_index);
 }
 
+void IndexReader::SampleKeys(size_t max_num, std::vector<std::string>& keys) const
+{
+	size_t L1_num = m_L1indexs.size();
+	if(L1_num == 0 || max_num == 0)
+	{
+		return;
+	}
+	//L1块大小相近，每块抽取相同的个数；L1块多于max_num时均匀选取其中的块
+	size_t block_num = MIN(L1_num, max_num);
+	size_t num_per_block = max_num / block_num;
+	keys.reserve(keys.size() + block_num * num_per_block);
+	for(size_t i = 0; i < block_num; ++i)
+	{
+		IndexBlockReader block(*this);
+		if(block.Read(m_L1indexs[i * L1_num / block_num]) != OK)
+		{
+			continue;
+		}
+		IndexBlockReaderIteratorPtr iter = block.NewIterator();
+		size_t L0_num = 0;
+		for(; iter->Valid(); iter->Next())
+		{
+			++L0_num;
+		}
+		size_t step = MAX(L0_num / num_per_block, (size_t)1);
+		size_t idx = 0, cnt = 0;
+		for(iter->First(); iter->Valid() && cnt < num_per_block; iter->Next(), ++idx)
+		{
+			if(idx % step == 0)
+			{
+				const StrView& key = iter->L0Index().start_key;
+				keys.emplace_back(key.data, key.size);
+				++cnt;
+			}
+		}
+	}
+}
+
 
 ////////////////////////////////////////////////////////////
 IndexWriter::IndexWriter(const BucketConfig& bucket_conf, BlockPool& pool)
-	: m_bucket_conf(bucket_conf), m_large_block_pool(pool), m_L1key_buf(pool), m_L0key_buf(pool)
+	: m_bucket_conf(bucket_conf), m_large_block_pool(pool), m_rate_limiter(Engine::GetEngine()->GetRateLimiter()), 
+	  m_async_writer(m_file, pool, m_rate_limiter, Engine::GetEngine()->GetAsyncWritePool()), m_L1key_buf(pool), m_L0key_buf(pool)
 {
 	m_offset = 0;
+	m_version = SEPARATE_INDEX_FILE_VERSION;
+	m_bypass_cache = false;
 	m_L1offset_start = 0;
 	m_L2offset_start = 0;
 	
@@ -362,6 +456,7 @@ IndexWriter::IndexWriter(const BucketConfig& bucket_conf, BlockPool& pool)
 
 IndexWriter::~IndexWriter()
 {
+	m_async_writer.Finish();
 	m_file.Close();
 	
 	char file_path[MAX_PATH_LEN], tmp_file_path[MAX_PATH_LEN];
@@ -373,10 +468,12 @@ IndexWriter::~IndexWriter()
 	m_large_block_pool.Free(m_block_start);
 }
 
-Status IndexWriter::Create(const char* bucket_path, fileid_t fileid)
+Status IndexWriter::Create(const char* bucket_path, fileid_t fileid, bool single_file, uint64_t expected_size, bool bypass_cache)
 {
 	StrCpy(m_bucket_path, sizeof(m_bucket_path), bucket_path);
 	m_segment_fileid = fileid;
+	m_version = single_file ? INDEX_FILE_VERSION : SEPARATE_INDEX_FILE_VERSION;
+	m_bypass_cache = single_file && bypass_cache;
 	
 	char file_path[MAX_PATH_LEN];
 	MakeTmpIndexFilePath(bucket_path, fileid, file_path);
@@ -386,7 +483,7 @@ Status IndexWriter::Create(const char* bucket_path, fileid_t fileid)
 		return ERR_FILE_WRITE;
 	}
 	
-	m_block_ptr = WriteIndexFileHeader(m_block_start);
+	m_block_ptr = WriteIndexFileHeader(m_block_start, m_version);
 	m_L1offset_start = m_block_ptr - m_block_start;
 	
 	//写head
@@ -395,10 +492,33 @@ Status IndexWriter::Create(const char* bucket_path, fileid_t fileid)
 		return ERR_FILE_WRITE;
 	}
 	m_offset = m_L1offset_start;
+	m_async_writer.Start(m_offset, expected_size, Engine::GetEngine()->GetConfig().bytes_per_sync, m_bypass_cache ? file_path : nullptr);
 	
 	return OK;
 }
 
+Status IndexWriter::WriteDataBlock(byte_t* block, uint32_t size)
+{
+	assert(m_version >= INDEX_FILE_VERSION);
+	if(!m_async_writer.Write(block, size))
+	{
+		return ERR_FILE_WRITE;
+	}
+	m_offset += size;
+	return OK;
+}
+
+//将当前块提交给io线程写入，并换一个新块
+Status IndexWriter::SubmitBlock(uint32_t size, const std::string* prefix)
+{
+	byte_t* block = m_block_start;
+	m_block_start = m_large_block_pool.Alloc();
+	m_block_end = m_block_start + m_large_block_pool.BlockSize();
+	m_block_ptr = m_block_start;
+
+	return m_async_writer.Write(block, size, prefix) ? OK : ERR_FILE_WRITE;
+}
+
 
 Status IndexWriter::WriteGroup(uint32_t& L0_idx, L0GroupIndex& gi)
 {	
@@ -592,9 +712,10 @@ Status IndexWriter::WriteBlock(std::deque<uint32_t>& key_hashcodes)
 	L1_index.L1index_size = index_size;
 
 	//写block
-	if(m_file.Write(bloom_filter_data.data(), bloom_filter_data.size(), m_block_start, block_size) != total_size)
+	Status s = SubmitBlock(block_size, bloom_filter_data.empty() ? nullptr : &bloom_filter_data);
+	if(s != OK)
 	{
-		return ERR_FILE_WRITE;
+		return s;
 	}
 	m_L1indexs.push_back(L1_index);
 	
@@ -605,6 +726,10 @@ Status IndexWriter::WriteBlock(std::deque<uint32_t>& key_hashcodes)
 
 Status IndexWriter::Write(const SegmentL0Index& L0_index, std::deque<uint32_t>& key_hashcodes)
 {
+	if(m_min_key.empty())
+	{
+		m_min_key.assign(L0_index.start_key.data, L0_index.start_key.size);
+	}
 	//TODO:构建最短key
 	m_L0indexs.push_back(L0_index);
 	m_L0indexs.back().start_key = CloneKey(m_L0key_buf, L0_index.start_key);
@@ -633,23 +758,28 @@ Status IndexWriter::WriteL2Index(uint32_t& L2index_size)
 	m_block_ptr = EncodeV64(m_block_ptr, m_L1offset_start);
 	
 	m_block_ptr = EncodeV32(m_block_ptr, m_L1indexs.size());
+	uint64_t last_offset = m_L1offset_start;
 	for(auto it = m_L1indexs.begin(); it != m_L1indexs.end(); ++it)
 	{
 		//剩余空间不足时刷盘
 		if(m_block_ptr - m_block_start <= (ssize_t)it->start_key.size + EXTRA_OBJECT_SIZE)
 		{
 			uint32_t size = m_block_ptr - m_block_start;
-			if(m_file.Write(m_block_start, size) != size)
+			Status s = SubmitBlock(size);
+			if(s != OK)
 			{
-				return ERR_FILE_WRITE;
+				return s;
 			}
 			m_offset += size;
 			L2index_size += size;
-
-			m_block_ptr = m_block_start;
 		}
 		
 		m_block_ptr = EncodeString(m_block_ptr, it->start_key.data, it->start_key.size);
+		if(m_version >= INDEX_FILE_VERSION)
+		{
+			m_block_ptr = EncodeV64(m_block_ptr, it->L1offset - last_offset);
+			last_offset = it->L1offset + it->L1compress_size;
+		}
 		//如果bloom_len不为空
 		if(m_bucket_conf.bloom_filter_bitnum != 0)
 		{
@@ -665,9 +795,10 @@ Status IndexWriter::WriteL2Index(uint32_t& L2index_size)
 	m_block_ptr = Encode32(m_block_ptr, 0);//FIXME:crc填0
 
 	uint32_t size = m_block_ptr - m_block_start;
-	if(m_file.Write(m_block_start, size) != size)
+	Status s = SubmitBlock(size);
+	if(s != OK)
 	{
-		return ERR_FILE_WRITE;
+		return s;
 	}
 	m_offset += size;
 	L2index_size += size;
@@ -717,9 +848,10 @@ Status IndexWriter::WriteMeta(uint32_t L2index_size, const SegmentMeta& meta)
 	m_block_ptr = Encode32(m_block_ptr, meta_size);
 
 	uint32_t size = m_block_ptr - m_block_start;
-	if(m_file.Write(m_block_start, size) != size)
+	Status s = SubmitBlock(size);
+	if(s != OK)
 	{
-		return ERR_FILE_WRITE;
+		return s;
 	}
 	m_offset += size;
 
@@ -755,13 +887,22 @@ Status IndexWriter::Finish(std::deque<uint32_t>& key_hashcodes, const SegmentMet
 	{
 		return s;
 	}
+	if(!m_async_writer.Finish())
+	{
+		return ERR_FILE_WRITE;
+	}
     if(m_bucket_conf.sync_data)
     {
-        if(!m_file.Sync())
+        if(!m_file.DataSync())
         {
             return ERR_FILE_WRITE;
         }
     }
+	if(m_bypass_cache)
+	{
+		//丢弃未用O_DIRECT写入的首尾部分，未刷盘的脏页会被忽略
+		m_file.DropCache(0, 0);
+	}
 	return OK;
 }
 	
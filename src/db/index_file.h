@@ -25,6 +25,9 @@ limitations under the License.
 #include "buffer.h"
 #include "xfdb/strutil.h"
 #include "path.h"
+#include "rate_limiter.h"
+#include "async_file.h"
+#include "file_util.h"
 
 namespace xfdb 
 {
@@ -40,6 +43,8 @@ public:
 	bool Read(const SegmentL1Index* L1Index, std::string& bf_data, std::string& index_data) const;
 
 	Status Search(const StrView& key, SegmentL0Index& idx) const;
+	/**从各L1块中均匀抽取约max_num个data块的起始key*/
+	void SampleKeys(size_t max_num, std::vector<std::string>& keys) const;
  
 	inline const SegmentMeta& GetMeta() const
 	{
@@ -49,8 +54,18 @@ public:
 	{
 		return m_file.Size();
 	}
+	inline StrView MinKey() const
+	{
+		return m_L1indexs.empty() ? StrView() : m_L1indexs[0].start_key;
+	}
+	//data块是否也在本文件中
+	inline bool IsSingleFile() const
+	{
+		return m_version >= INDEX_FILE_VERSION;
+	}
 			
 private:
+	Status ReadHeader();
 	ssize_t Find(const StrView& key) const;
 	const SegmentL1Index* Search(const StrView& key) const;
 
@@ -62,12 +77,16 @@ private:
 	bool ParseKeyIndex(const byte_t* &data, const byte_t* data_end, uint64_t& last_offset, SegmentL1Index& L1Index);
 
 	bool CheckBloomFilter(const SegmentL1Index* L1Index, const StrView& key) const;
+	void AddCache(const SegmentL1Index* L1Index, const byte_t* buffer, std::string& bf_data, std::string& index_data) const;
+	std::string IndexCacheKey(const SegmentL1Index* L1Index) const;
 
 private:
 	BlockPool& m_large_block_pool;
 
 	File m_file;
-	std::string m_path;
+	FileMapping m_mapping;		//mmap_read时有效
+	std::string m_cache_key_prefix;
+	uint16_t m_version;
 	
 	WriteBuffer m_buf;
 	std::vector<SegmentL1Index> m_L1indexs;
@@ -76,6 +95,7 @@ private:
 private:
 	friend class SegmentReaderIterator;
 	friend class IndexBlockReader;
+	friend class DataReader;
 	
 	IndexReader(const IndexReader&) = delete;
 	IndexReader& operator=(const IndexReader&) = delete;
@@ -88,9 +108,21 @@ public:
 	~IndexWriter();
 	
 public:	
-	Status Create(const char* bucket_path, fileid_t fileid);
+	/**single_file为true时data块也写入本文件（见WriteDataBlock），expected_size和bypass_cache同DataWriter::Create*/
+	Status Create(const char* bucket_path, fileid_t fileid, bool single_file = false, uint64_t expected_size = 0, bool bypass_cache = false);
 	Status Write(const SegmentL0Index& L0_index, std::deque<uint32_t>& key_hashcodes);
 	Status Finish(std::deque<uint32_t>& key_hashcodes, const SegmentMeta& meta);
+
+	/**单文件segment时写入data块，block的所有权转给io线程*/
+	Status WriteDataBlock(byte_t* block, uint32_t size);
+	inline uint64_t Offset() const
+	{
+		return m_offset;
+	}
+	inline const std::string& MinKey() const
+	{
+		return m_min_key;
+	}
     
 	inline uint64_t FileSize()
 	{
@@ -115,16 +147,21 @@ private:
 	void WriteObjectStat(ObjectType type, const TypeObjectStat& stat);
 	
 	Status WriteL2IndexMeta(const SegmentMeta& meta);
+	Status SubmitBlock(uint32_t size, const std::string* prefix = nullptr);
 
 private:
 	const BucketConfig& m_bucket_conf;
 
 	BlockPool& m_large_block_pool;
+	RateLimiter& m_rate_limiter;
 
 	char m_bucket_path[MAX_PATH_LEN];
 	fileid_t m_segment_fileid;
 	File m_file;
+	AsyncFileWriter m_async_writer;		//与data文件并行写
 	uint64_t m_offset;
+	uint16_t m_version;
+	bool m_bypass_cache;
 	uint64_t m_L1offset_start;
 	uint64_t m_L2offset_start;
 	
@@ -136,6 +173,7 @@ private:
 	//String m_prev_key;
 
 	WriteBuffer m_L0key_buf;
+	std::string m_min_key;
 
 	byte_t* m_block_start;	//256KB-buffer
 	byte_t* m_block_end;
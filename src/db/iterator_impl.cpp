@@ -16,6 +16,7 @@ limitations under the License.
 
 #include "db_types.h"
 #include "iterator_impl.h"
+#include "object_reader.h"
 
 namespace xfdb 
 {
@@ -179,6 +180,178 @@ void IteratorSet::GetMaxObjectID()
     assert(m_max_object_id != INVALID_OBJECT_ID);
 }
 
-} 
+////////////////////////////////////////////////////////////////////////////////
+FilterIterator::FilterIterator(const IteratorImplPtr& iter)
+	: m_iter(iter)
+{
+	m_max_key = m_iter->MaxKey();
+	m_max_object_id = m_iter->MaxObjectID();
+
+	//NOTE: 构造函数中不能调用虚函数，由子类调用First()
+	m_obj_ptr = nullptr;
+	Reset();
+}
+
+void FilterIterator::Reset()
+{
+	m_has_object = false;
+	m_keep_deleted = false;
+	m_deleted_key.Clear();
+	m_deleted_id = INVALID_OBJECT_ID;
+}
+
+void FilterIterator::First()
+{
+	Reset();
+	m_iter->First();
+	Skip();
+}
+
+void FilterIterator::Seek(const StrView& key)
+{
+	Reset();
+	m_iter->Seek(key);
+	Skip();
+}
+
+void FilterIterator::Next()
+{
+	if(m_keep_deleted)
+	{
+		m_keep_deleted = false;
+		return;
+	}
+	m_iter->Next();
+	Skip();
+}
+
+bool FilterIterator::Valid() const
+{
+	return m_keep_deleted || m_iter->Valid();
+}
+
+void FilterIterator::Skip()
+{
+	for(; m_iter->Valid(); m_iter->Next())
+	{
+		const Object& obj = m_iter->object();
+		const Object* obj_ptr = Filter(obj);
+		if(obj_ptr != nullptr)
+		{
+			m_has_object = true;
+			m_obj_ptr = obj_ptr;
+			return;
+		}
+		m_deleted_key.Assign(obj.key.data, obj.key.size);
+		m_deleted_id = obj.id;
+	}
+
+	if(!m_has_object && !m_deleted_key.Empty())
+	{
+		m_has_object = true;
+		m_keep_deleted = true;
+		m_obj = Object(DeleteType, m_deleted_id, StrView(m_deleted_key.Data(), m_deleted_key.Size()));
+		m_obj_ptr = &m_obj;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+DeleteFilterIterator::DeleteFilterIterator(const IteratorImplPtr& iter)
+	: FilterIterator(iter)
+{
+	First();
+}
+
+const Object* DeleteFilterIterator::Filter(const Object& obj)
+{
+	if(obj.type == DeleteType)
+	{
+		return nullptr;
+	}
+	if(obj.type == AppendType)
+	{
+		//最底层没有更老的值，append即为set
+		m_obj = obj;
+		m_obj.type = SetType;
+		return &m_obj;
+	}
+	return &obj;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+ShadowFilterIterator::ShadowFilterIterator(const IteratorImplPtr& iter, const IteratorImplPtr& newer_iter)
+	: FilterIterator(iter), m_newer_iter(newer_iter)
+{
+	//newer_iter创建后已在第1个元素处
+	FilterIterator::First();
+}
+
+void ShadowFilterIterator::First()
+{
+	m_newer_iter->First();
+	FilterIterator::First();
+}
+
+void ShadowFilterIterator::Seek(const StrView& key)
+{
+	m_newer_iter->Seek(key);
+	FilterIterator::Seek(key);
+}
+
+const Object* ShadowFilterIterator::Filter(const Object& obj)
+{
+	//key递增，更新的迭代器只需顺序前进
+	for(; m_newer_iter->Valid(); m_newer_iter->Next())
+	{
+		int ret = m_newer_iter->object().key.Compare(obj.key);
+		if(ret > 0)
+		{
+			break;
+		}
+		if(ret == 0)
+		{
+			//IteratorSet已合并同一key的各版本，结果仍为append时需要依赖更老的值
+			return (m_newer_iter->object().type == AppendType) ? &obj : nullptr;
+		}
+	}
+	return &obj;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CompactionFilterIterator::CompactionFilterIterator(const IteratorImplPtr& iter, const CompactionFilterPtr& filter, bool on_read, bool drop_removed)
+	: FilterIterator(iter), m_filter(filter), m_on_read(on_read), m_drop_removed(drop_removed)
+{
+	First();
+}
 
+const Object* CompactionFilterIterator::Filter(const Object& obj)
+{
+	//append依赖更老的值，非最底层时不处理
+	if(obj.type != SetType)
+	{
+		return &obj;
+	}
 
+	CompactionFilter::Decision decision = m_filter->Filter(obj.key, obj.value, m_new_value);
+	if(decision == CompactionFilter::REMOVE)
+	{
+		if(m_drop_removed)
+		{
+			return nullptr;
+		}
+		//转为删除标记，覆盖更老segment中的值
+		m_obj = obj;
+		m_obj.type = DeleteType;
+		m_obj.value.Set(nullptr, 0);
+		return &m_obj;
+	}
+	else if(decision == CompactionFilter::CHANGE_VALUE && !m_on_read)
+	{
+		m_obj = obj;
+		m_obj.value.Set(m_new_value.data(), m_new_value.size());
+		return &m_obj;
+	}
+	return &obj;
+}
+
+} 
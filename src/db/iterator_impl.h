@@ -112,6 +112,100 @@ private:
 	IteratorSet& operator=(const IteratorSet&) = delete;
 };
 
+//过滤Iterator基类，全部被过滤时在最后输出一个删除标记，避免生成空的segment
+class FilterIterator : public IteratorImpl 
+{
+public:
+	explicit FilterIterator(const IteratorImplPtr& iter);
+	virtual ~FilterIterator(){}
+
+public:
+	/**移到第1个元素处*/
+	virtual void First() override;
+	
+	/**移到到>=key的地方*/
+	virtual void Seek(const StrView& key) override;
+	
+	/**向后移到一个元素*/
+	virtual void Next() override;
+
+	/**是否还有下一个元素*/
+	virtual bool Valid() const override;
+
+protected:
+	//返回需输出的object（obj或m_obj），返回nullptr表示过滤掉
+	virtual const Object* Filter(const Object& obj) = 0;
+
+private:
+	void Reset();
+	void Skip();
+
+protected:
+	IteratorImplPtr m_iter;
+	Object m_obj;
+
+private:
+	bool m_has_object;
+	bool m_keep_deleted;
+	String m_deleted_key;
+	objectid_t m_deleted_id;
+	
+private:
+	FilterIterator(const FilterIterator&) = delete;
+	FilterIterator& operator=(const FilterIterator&) = delete;
+};
+
+//合并到最底层时使用，过滤掉删除标记，并将append转为set
+class DeleteFilterIterator : public FilterIterator 
+{
+public:
+	explicit DeleteFilterIterator(const IteratorImplPtr& iter);
+	virtual ~DeleteFilterIterator(){}
+
+protected:
+	virtual const Object* Filter(const Object& obj) override;
+};
+
+//重写segment时使用，过滤掉被更新的reader覆盖（set或delete）的object
+class ShadowFilterIterator : public FilterIterator 
+{
+public:
+	//newer_iter: 更新的reader的迭代器（多个时为IteratorSet），随iter顺序前进，不逐个key点查
+	ShadowFilterIterator(const IteratorImplPtr& iter, const IteratorImplPtr& newer_iter);
+	virtual ~ShadowFilterIterator(){}
+
+public:
+	/**移到第1个元素处*/
+	virtual void First() override;
+	
+	/**移到到>=key的地方*/
+	virtual void Seek(const StrView& key) override;
+
+protected:
+	virtual const Object* Filter(const Object& obj) override;
+
+private:
+	IteratorImplPtr m_newer_iter;
+};
+
+//调用bucket配置的CompactionFilter，merge时可删除或修改set对象，读取时只过滤被删除的对象
+class CompactionFilterIterator : public FilterIterator 
+{
+public:
+	//on_read: 读取时使用（只处理REMOVE），drop_removed: REMOVE的对象直接丢弃，否则转为删除标记
+	CompactionFilterIterator(const IteratorImplPtr& iter, const CompactionFilterPtr& filter, bool on_read, bool drop_removed);
+	virtual ~CompactionFilterIterator(){}
+
+protected:
+	virtual const Object* Filter(const Object& obj) override;
+
+private:
+	CompactionFilterPtr m_filter;
+	bool m_on_read;
+	bool m_drop_removed;
+	std::string m_new_value;
+};
+
 } 
 
 #endif 
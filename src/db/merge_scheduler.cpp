@@ -0,0 +1,157 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+
+#include "merge_scheduler.h"
+#include "writeonly_bucket.h"
+#include "db_impl.h"
+
+namespace xfdb 
+{
+
+MergeScheduler::MergeScheduler()
+{
+	m_exit_num = 0;
+}
+
+MergeScheduler::~MergeScheduler()
+{
+}
+
+void MergeScheduler::Push(const NotifyMsg& msg)
+{
+	if(msg.type == NOTIFY_EXIT)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_exit_num;
+		m_cond.notify_all();
+		return;
+	}
+
+	//评分需要访问bucket，不在锁内进行
+	double score = GetScore(msg);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	//同一bucket只保留一个待合并请求，以最新的分数为准
+	Bucket* bucket = msg.bucket.get();
+	auto it = m_pending_tasks.find(bucket);
+	if(it != m_pending_tasks.end())
+	{
+		m_score_queue.erase(it->second.pos);
+		if(score < 1.0)
+		{
+			m_pending_tasks.erase(it);
+			return;
+		}
+	}
+	else if(score < 1.0)
+	{
+		return;
+	}
+	else
+	{
+		it = m_pending_tasks.insert(std::make_pair(bucket, PendingTask())).first;
+	}
+
+	PendingTask& task = it->second;
+	task.msg = msg;
+	task.score = score;
+	task.pos = m_score_queue.insert(std::make_pair(score, bucket));
+	m_cond.notify_one();
+}
+
+double MergeScheduler::GetScore(const NotifyMsg& msg)
+{
+	WriteOnlyBucket* bucket = (WriteOnlyBucket*)msg.bucket.get();
+	return bucket->GetMergeScore();
+}
+
+void MergeScheduler::Pop(NotifyMsg& msg)
+{
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_score_queue.empty() && m_exit_num == 0)
+			{
+				m_cond.wait(lock);
+			}
+			if(m_exit_num != 0)
+			{
+				--m_exit_num;
+				msg = NotifyMsg(NOTIFY_EXIT);
+				return;
+			}
+			auto it = m_pending_tasks.find(m_score_queue.begin()->second);
+			assert(it != m_pending_tasks.end());
+			msg = it->second.msg;
+			m_score_queue.erase(it->second.pos);
+			m_pending_tasks.erase(it);
+		}
+
+		//缓存的分数可能已过期（如其他线程已开始合并），只重新检查取出的bucket
+		RunningTask task = {msg, GetScore(msg)};
+		if(task.score >= 1.0)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running_tasks.insert(std::make_pair(msg.bucket.get(), task));
+			return;
+		}
+	}
+}
+
+void MergeScheduler::Done(const NotifyMsg& msg)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_running_tasks.find(msg.bucket.get());
+	if(it != m_running_tasks.end())
+	{
+		m_running_tasks.erase(it);
+	}
+}
+
+void MergeScheduler::ToStat(const NotifyMsg& msg, double score, MergeTaskStat& stat)
+{
+	stat.db_path = msg.db->GetPath();
+	stat.bucket_name = msg.bucket->Info().name;
+	stat.score = score;
+}
+
+void MergeScheduler::GetStat(MergeQueueStat& stat)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	stat.running_tasks.resize(m_running_tasks.size());
+	size_t i = 0;
+	for(auto it = m_running_tasks.begin(); it != m_running_tasks.end(); ++it, ++i)
+	{
+		ToStat(it->second.msg, it->second.score, stat.running_tasks[i]);
+	}
+
+	//m_score_queue已按分数从高到低排列
+	stat.pending_tasks.resize(m_score_queue.size());
+	i = 0;
+	for(auto it = m_score_queue.begin(); it != m_score_queue.end(); ++it, ++i)
+	{
+		auto pit = m_pending_tasks.find(it->second);
+		assert(pit != m_pending_tasks.end());
+		ToStat(pit->second.msg, pit->second.score, stat.pending_tasks[i]);
+	}
+}
+
+}  
+
@@ -0,0 +1,84 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+
+#ifndef __xfdb_merge_scheduler_h__
+#define __xfdb_merge_scheduler_h__
+
+#include <map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "db_types.h"
+#include "notify_msg.h"
+
+namespace xfdb 
+{
+
+//part merge调度器：按bucket去重，每次取合并分数最高的bucket执行
+//分数在通知时计算并缓存，队列按缓存分数排序，取出时只重新检查被取出的bucket
+class MergeScheduler
+{
+public:
+	MergeScheduler();
+	~MergeScheduler();
+
+public:
+	//NOTIFY_EXIT消息用于通知一个工作线程退出
+	void Push(const NotifyMsg& msg);
+
+	//取出分数最高的任务，重新检查后分数<1的任务直接丢弃
+	void Pop(NotifyMsg& msg);
+
+	//任务执行完成
+	void Done(const NotifyMsg& msg);
+
+	void GetStat(MergeQueueStat& stat);
+
+private:
+	typedef std::multimap<double, Bucket*, std::greater<double>> ScoreQueue;
+	struct PendingTask
+	{
+		NotifyMsg msg;
+		double score;
+		ScoreQueue::iterator pos;	//在m_score_queue中的位置
+	};
+	struct RunningTask
+	{
+		NotifyMsg msg;
+		double score;
+	};
+	static double GetScore(const NotifyMsg& msg);
+	static void ToStat(const NotifyMsg& msg, double score, MergeTaskStat& stat);
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	uint32_t m_exit_num;
+	std::map<Bucket*, PendingTask> m_pending_tasks;		//待合并的bucket
+	ScoreQueue m_score_queue;							//按缓存分数从高到低排列的待合并bucket
+	std::multimap<Bucket*, RunningTask> m_running_tasks;	//正在合并的bucket
+
+private:
+	MergeScheduler(const MergeScheduler&) = delete;
+	MergeScheduler& operator=(const MergeScheduler&) = delete;
+};
+
+}  
+
+#endif
+
@@ -43,9 +43,11 @@ public:
 	}
 	static xfutil::tid_t GetNotifyPID(const char* file_path);
 
-private:
+	//通知环形缓冲区中的消息使用相同的格式
 	static Status Parse(const byte_t* data, uint32_t size, NotifyData& nd);
 	static Status Serialize(const NotifyData& nd, String& str);
+
+private:
 	static constexpr uint32_t EstimateSize(const NotifyData& dm);
 
 private:
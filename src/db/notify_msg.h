@@ -40,6 +40,9 @@ enum NotifyType
 	NOTIFY_TRY_FLUSH,
 
 	NOTIFY_CLEAN_DB,
+
+	NOTIFY_BOTTOM_REWRITE,
+	NOTIFY_RANGE_MERGE,
 };
 
 struct NotifyData
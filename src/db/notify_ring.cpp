@@ -0,0 +1,181 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#include <chrono>
+#include "notify_ring.h"
+#include "notify_file.h"
+#include "file_util.h"
+#include "coding.h"
+#include "futex.h"
+#include "thread.h"
+#include "logger.h"
+
+using namespace xfutil;
+
+namespace xfdb 
+{
+
+//写进程在写入中途退出时，该槽最多等待此时间后跳过
+#define MAX_SLOT_PENDING_MS		1000
+
+NotifyRing::NotifyRing()
+{
+	m_write_seq = nullptr;
+	m_futex = nullptr;
+	m_slots = nullptr;
+	m_read_seq = 0;
+}
+
+NotifyRing::~NotifyRing()
+{
+}
+
+Status NotifyRing::Open(const char* notify_dir, bool writable)
+{
+	char path[MAX_PATH_LEN];
+	MakeNotifyRingFilePath(notify_dir, path);
+
+	auto init = [](byte_t* data)
+	{
+		byte_t* ptr = WriteNotifyRingFileHeader(data);
+		ptr = Encode32(ptr, SLOT_NUM);
+		ptr = Encode32(ptr, SLOT_SIZE);
+	};
+	if(!m_shm.Open(path, HEAD_SIZE + (uint64_t)SLOT_NUM * SLOT_SIZE, writable, init))
+	{
+		return ERR_FILE_OPEN;
+	}
+
+	//槽数和槽大小不同的旧文件不能使用
+	const byte_t* data = m_shm.Data();
+	FileHeader header;
+	if(!ParseNotifyRingFileHeader(data, HEAD_SIZE, header) || Decode32(data) != SLOT_NUM || Decode32(data) != SLOT_SIZE)
+	{
+		m_shm.Close();
+		return ERR_FILE_FORMAT;
+	}
+	m_write_seq = (std::atomic<uint64_t>*)(m_shm.Data() + WRITE_SEQ_OFF);
+	m_futex = (std::atomic<uint32_t>*)(m_shm.Data() + FUTEX_OFF);
+	m_slots = m_shm.Data() + HEAD_SIZE;
+
+	//只接收打开之后的通知
+	m_read_seq = m_write_seq->load(std::memory_order_acquire);
+	return OK;
+}
+
+Status NotifyRing::Write(const NotifyData& nd)
+{
+	String str;
+	Status s = NotifyFile::Serialize(nd, str);
+	if(s != OK)
+	{
+		return s;
+	}
+	if(str.Size() > SLOT_DATA_SIZE)
+	{
+		return ERR_OBJECT_TOO_LARGE;
+	}
+
+	uint64_t seq = m_write_seq->fetch_add(1, std::memory_order_acq_rel);
+	Slot* slot = GetSlot(seq);
+
+	slot->seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot->size = str.Size();
+	memcpy(slot->data, str.Data(), str.Size());
+	slot->seq.store(seq + 1, std::memory_order_release);
+
+	m_futex->fetch_add(1, std::memory_order_release);
+	FutexWakeAll(m_futex);
+	return OK;
+}
+
+bool NotifyRing::Read(NotifyData& nd, uint32_t timeout_ms)
+{
+	byte_t buf[SLOT_DATA_SIZE];
+	std::chrono::steady_clock::time_point pending_start;
+	bool pending = false;
+
+	for(;;)
+	{
+		uint32_t futex_val = m_futex->load(std::memory_order_acquire);
+		uint64_t write_seq = m_write_seq->load(std::memory_order_acquire);
+		if(m_read_seq >= write_seq)
+		{
+			FutexWait(m_futex, futex_val, timeout_ms);
+			return false;
+		}
+		if(write_seq - m_read_seq > SLOT_NUM)
+		{
+			LogWarn("notify ring overrun, %lu notifies lost", write_seq - m_read_seq - SLOT_NUM);
+			m_read_seq = write_seq - SLOT_NUM;
+		}
+
+		const Slot* slot = GetSlot(m_read_seq);
+		uint64_t seq = slot->seq.load(std::memory_order_acquire);
+		if(seq != m_read_seq + 1)
+		{
+			if(seq > m_read_seq + 1)
+			{
+				//已被覆盖，下一轮按overrun处理
+				continue;
+			}
+			//写进程已占用序号但未写完
+			auto now = std::chrono::steady_clock::now();
+			if(!pending)
+			{
+				pending = true;
+				pending_start = now;
+			}
+			else if(std::chrono::duration_cast<std::chrono::milliseconds>(now - pending_start).count() >= MAX_SLOT_PENDING_MS)
+			{
+				LogWarn("notify ring slot(seq=%lu) not written, skipped", m_read_seq);
+				++m_read_seq;
+				pending = false;
+			}
+			Thread::Yield();
+			continue;
+		}
+		pending = false;
+
+		uint32_t size = MIN(slot->size, SLOT_DATA_SIZE);
+		memcpy(buf, slot->data, size);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(slot->seq.load(std::memory_order_relaxed) != seq)
+		{
+			continue;
+		}
+		++m_read_seq;
+
+		if(NotifyFile::Parse(buf, size, nd) == OK)
+		{
+			return true;
+		}
+		LogWarn("parse notify ring slot(seq=%lu) failed", seq - 1);
+	}
+	return false;
+}
+
+void NotifyRing::Wakeup()
+{
+	if(m_futex != nullptr)
+	{
+		FutexWakeAll(m_futex);
+	}
+}
+
+}  
+
@@ -0,0 +1,93 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#ifndef __xfdb_notify_ring_h__
+#define __xfdb_notify_ring_h__
+
+#include <atomic>
+#include "db_types.h"
+#include "file.h"
+#include "notify_msg.h"
+
+namespace xfdb 
+{
+
+//通知环形缓冲区：notify_dir下的共享内存文件，可替代通知文件
+//写进程（可多个）追加消息后通过futex唤醒只读进程，不写文件、不fsync；只读进程只读映射，各自记录读取位置
+class NotifyRing
+{
+public:
+	NotifyRing();
+	~NotifyRing();
+	
+public:	
+	/**打开notify_dir下的环形缓冲区，不存在时创建；writable为false时只读*/
+	Status Open(const char* notify_dir, bool writable);
+
+	/**追加一条通知，消息超过槽大小时返回ERR_OBJECT_TOO_LARGE，由调用者改写通知文件*/
+	Status Write(const NotifyData& nd);
+
+	/**读取下一条通知，没有时最多等待timeout_ms；超时或被Wakeup唤醒时返回false*/
+	bool Read(NotifyData& nd, uint32_t timeout_ms);
+
+	/**唤醒等待中的Read*/
+	void Wakeup();
+
+	inline bool Opened() const
+	{
+		return m_shm.Opened();
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<uint64_t> seq;		//写完后为消息序号+1，写入中为0
+		uint32_t size;
+		uint32_t reserved;
+		byte_t data[0];
+	};
+
+	inline Slot* GetSlot(uint64_t seq) const
+	{
+		return (Slot*)(m_slots + (seq % SLOT_NUM) * SLOT_SIZE);
+	}
+
+private:
+	static constexpr uint32_t SLOT_NUM = 1024;
+	static constexpr uint32_t SLOT_SIZE = 512;
+	static constexpr uint32_t SLOT_DATA_SIZE = SLOT_SIZE - sizeof(Slot);
+	static constexpr uint32_t WRITE_SEQ_OFF = 64;	//各占一个cache line
+	static constexpr uint32_t FUTEX_OFF = 128;
+	static constexpr uint32_t HEAD_SIZE = 256;
+
+	xfutil::SharedMemory m_shm;
+	std::atomic<uint64_t>* m_write_seq;		//下一条消息的序号
+	std::atomic<uint32_t>* m_futex;			//每写入一条加1
+	byte_t* m_slots;
+
+	uint64_t m_read_seq;					//本进程下一条要读的序号
+
+private:
+	NotifyRing(const NotifyRing&) = delete;
+	NotifyRing& operator=(const NotifyRing&) = delete;
+	
+};
+
+
+}  
+
+#endif
+
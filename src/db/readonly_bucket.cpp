@@ -17,6 +17,7 @@ limitations under the License.
 #include "readonly_bucket.h"
 #include "object_reader_snapshot.h"
 #include "readonly_db.h"
+#include "engine.h"
 
 namespace xfdb 
 {
@@ -57,7 +58,7 @@ Status ReadOnlyBucket::Get(const StrView& key, std::string& value)
 	ObjectType type;
 	if(reader_snapshot && reader_snapshot->Get(key, curr_obj_id, type, value) == OK)
 	{
-        return (type == DeleteType) ? ERR_OBJECT_NOT_EXIST : OK;
+        return (type == DeleteType || IsFilteredOnRead(key, value)) ? ERR_OBJECT_NOT_EXIST : OK;
 	}
     return ERR_OBJECT_NOT_EXIST;
 }
@@ -72,6 +73,7 @@ Status ReadOnlyBucket::NewIterator(IteratorImplPtr& iter)
     if(reader_snapshot)
     {
         iter = reader_snapshot->NewIterator();
+        FilterOnRead(iter);
         return OK;
     }
     return ERR_BUCKET_EMPTY;
@@ -91,6 +93,10 @@ void ReadOnlyBucket::GetStat(BucketStat& stat) const
 	}
 }
 
-}  
+bool ReadOnlyBucket::LazyOpenSegment() const
+{
+	return Engine::GetEngine()->GetConfig().lazy_open_segment;
+}
 
+}
 
@@ -39,6 +39,9 @@ public:
 	virtual Status NewIterator(IteratorImplPtr& iter) override;
 
 	virtual void GetStat(BucketStat& stat) const override;
+
+protected:
+	virtual bool LazyOpenSegment() const override;
 		
 private:
 };
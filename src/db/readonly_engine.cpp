@@ -23,6 +23,8 @@ limitations under the License.
 #include "notify_file.h"
 #include "bucket.h"
 #include "process.h"
+#include "directory.h"
+#include "path.h"
 
 namespace xfdb 
 {
@@ -30,6 +32,7 @@ namespace xfdb
 ReadOnlyEngine::ReadOnlyEngine(const GlobalConfig& conf) : Engine(conf)
 {
 	m_reload_queues = nullptr;
+	m_ring_stopped = false;
 }
 
 ReadOnlyEngine::~ReadOnlyEngine()
@@ -40,6 +43,11 @@ ReadOnlyEngine::~ReadOnlyEngine()
 ////////////////////////////////////////////////////////////////////////////////
 Status ReadOnlyEngine::Start_()
 {
+	if(!m_conf.shared_cache_dir.empty())
+	{
+		AttachSharedCache();
+	}
+
 	if(m_conf.auto_reload_db)
 	{
 		m_reload_queues = new BlockingQueue<NotifyData>[m_conf.reload_db_thread_num];
@@ -50,6 +58,19 @@ Status ReadOnlyEngine::Start_()
 			return ERR_PATH_CREATE;
 		}	
 		m_notify_thread.Start(ReadNotifyThread, this);
+
+		if(m_conf.shm_notify)
+		{
+			Status s = m_notify_ring.Open(m_conf.notify_dir.c_str(), false);
+			if(s == OK)
+			{
+				m_ring_thread.Start(ReadNotifyRingThread, this);
+			}
+			else
+			{
+				LogWarn("open notify ring in %s failed, status: %d", m_conf.notify_dir.c_str(), s);
+			}
+		}
 	}	
 
 	return OK;
@@ -63,6 +84,13 @@ void ReadOnlyEngine::Stop_()
 		NotifyData nd;
 		NotifyFile::Write(m_conf.notify_dir.c_str(), nd);
 		m_notify_thread.Join();
+
+		if(m_notify_ring.Opened())
+		{
+			m_ring_stopped = true;
+			m_notify_ring.Wakeup();
+			m_ring_thread.Join();
+		}
 		
 		//往reload队列中写入退出标记
 		for(size_t i = 0; i < m_conf.reload_db_thread_num; ++i)
@@ -75,6 +103,35 @@ void ReadOnlyEngine::Stop_()
 	}
 }
 
+void ReadOnlyEngine::AttachSharedCache()
+{
+	const char* dir = m_conf.shared_cache_dir.c_str();
+	if(!Directory::Exist(dir) && !Directory::Create(dir))
+	{
+		LogWarn("create shared cache dir %s failed, errno: %d", dir, LastError);
+		return;
+	}
+
+	const struct
+	{
+		const char* name;
+		BlockCache& cache;
+	} caches[] = {
+		{"index.cache", m_index_cache},
+		{"data.cache", m_data_cache},
+		{"bloom_filter.cache", m_bloom_filter_cache},
+	};
+	char path[MAX_PATH_LEN];
+	for(const auto& c : caches)
+	{
+		Path::Combine(path, sizeof(path), dir, c.name);
+		if(!c.cache.Attach(path))
+		{
+			LogWarn("attach shared cache %s failed, use private cache", path);
+		}
+	}
+}
+
 DBImplPtr ReadOnlyEngine::NewDB(const DBConfig& conf, const std::string& db_path)
 {
 	return NewReadOnlyDB(conf, db_path);
@@ -224,6 +281,25 @@ void ReadOnlyEngine::ReadNotifyThread(void* arg)
 	LogDebug("read notify thread exit");		
 }
 
+void ReadOnlyEngine::ReadNotifyRingThread(void* arg)
+{
+	LogDebug("read notify ring thread started");	
+	
+	ReadOnlyEngine* engine = (ReadOnlyEngine*)arg;
+	assert(engine != nullptr);
+
+	NotifyData nd;
+	while(!engine->m_ring_stopped)
+	{
+		if(engine->m_notify_ring.Read(nd, 1000))
+		{
+			engine->PostNotifyData(nd);
+		}
+	}
+
+	LogDebug("read notify ring thread exit");		
+}
+
 
 }  
 
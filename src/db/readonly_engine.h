@@ -26,6 +26,7 @@ limitations under the License.
 #include "file_notify.h"
 #include "engine.h"
 #include "notify_file.h"
+#include "notify_ring.h"
 
 namespace xfdb 
 {
@@ -49,6 +50,9 @@ private:
 	void ProcessNotifyData(const NotifyData& nd);
 	
 	static void ReadNotifyThread(void* arg);
+	static void ReadNotifyRingThread(void* arg);
+
+	void AttachSharedCache();
 	
 private:	
 	BlockingQueue<NotifyData>* m_reload_queues;
@@ -56,6 +60,10 @@ private:
 	
 	FileNotify m_file_notify;
 	Thread m_notify_thread;
+
+	NotifyRing m_notify_ring;
+	Thread m_ring_thread;
+	std::atomic<bool> m_ring_stopped;
 	
 private:	
 	ReadOnlyEngine(const ReadOnlyEngine&) = delete;
@@ -89,7 +89,7 @@ Status ReadWriteBucket::Get(const StrView& key, std::string& value)
         {
             value.append(values[idx]);
         }
-        return OK;
+        return IsFilteredOnRead(key, value) ? ERR_OBJECT_NOT_EXIST : OK;
     }
 	return ERR_OBJECT_NOT_EXIST;
 
@@ -120,13 +120,18 @@ Status ReadWriteBucket::NewIterator(IteratorImplPtr& iter)
         IteratorImplPtr iter = writer_snapshot->NewIterator();
         iters.push_back(iter);
     }
-    if(reader_snapshot)
+    if(reader_snapshot && !reader_snapshot->Readers().empty())
     {
         IteratorImplPtr iter = reader_snapshot->NewIterator();
         iters.push_back(iter);
     }
 
-    iter = NewIteratorSet(iters);
+    if(iters.empty())
+    {
+        return ERR_BUCKET_EMPTY;
+    }
+    iter = (iters.size() == 1) ? iters[0] : NewIteratorSet(iters);
+    FilterOnRead(iter);
     return OK;
 }
 
@@ -19,50 +19,185 @@ limitations under the License.
 #include "object_writer_snapshot.h"
 #include "object_writer.h"
 #include "object_reader_snapshot.h"
+#include "iterator_impl.h"
+#include "logger.h"
 #include "engine.h"
 
 namespace xfdb 
 {
 
-SegmentReader::SegmentReader()
+Status SegmentTable::Open(const char* bucket_path, const SegmentStat& info)
+{
+	Status s = index_reader.Open(bucket_path, info);
+	if(s != OK)
+	{
+		return s;
+	}
+	if(index_reader.IsSingleFile())
+	{
+		data_reader.Open(index_reader);
+	}
+	else
+	{
+		s = data_reader.Open(bucket_path, info.segment_fileid);
+	}
+	opened = (s == OK);
+	return s;
+}
+
+SegmentReader::SegmentReader() : m_use_table_cache(false), m_table_opened(false)
 {
 }
 
 SegmentReader::~SegmentReader()
 {
+	//从表缓存中移除，使已删除的segment文件及时关闭
+	EnginePtr& engine = Engine::GetEngine();
+	if(m_use_table_cache && engine)
+	{
+		engine->GetTableCache().Delete(this);
+	}
 }
 
-Status SegmentReader::Open(const char* bucket_path, const SegmentStat& info)
+Status SegmentReader::Open(const char* bucket_path, const SegmentStat& info, bool lazy)
 {
+	EnginePtr& engine = Engine::GetEngine();
+	//旧的bucket meta中没有key范围和object统计，只能打开index文件获取
+	if(info.max_key.empty() || info.object_stat.Count() == 0)
+	{
+		lazy = false;
+	}
+
+	SegmentTablePtr table;
+	if(!lazy)
+	{
+		table = NewSegmentTable();
+		Status s = table->Open(bucket_path, info);
+		if(s != OK)
+		{
+			return s;
+		}
+	}
+	m_bucket_path = bucket_path;
 	m_segment_stat = info;
-	Status s = m_index_reader.Open(bucket_path, info);
-	if(s != OK)
+	m_use_table_cache = (engine->GetConfig().max_open_files != 0);
+
+	//保存table关闭后仍需使用的元数据
+	if(table)
 	{
-		return s;
+		const IndexReader& index_reader = table->index_reader;
+		m_meta = index_reader.GetMeta();
+		if(m_segment_stat.max_key.empty())
+		{
+			//补全后随下一个bucket meta写入
+			m_segment_stat.min_key.assign(index_reader.MinKey().data, index_reader.MinKey().size);
+			m_segment_stat.max_key.assign(m_meta.max_key.data, m_meta.max_key.size);
+			m_segment_stat.max_object_id = m_meta.max_object_id;
+			m_segment_stat.max_merge_segment_id = m_meta.max_merge_segment_id;
+		}
+		m_segment_stat.object_stat = m_meta.object_stat;
 	}
-	s = m_data_reader.Open(bucket_path, info.segment_fileid);
-    if(s != OK)
-    {
-        return s;
-    }
+	m_meta.max_key = StrView(m_segment_stat.max_key);
+	m_meta.max_object_id = m_segment_stat.max_object_id;
+	m_meta.max_merge_segment_id = m_segment_stat.max_merge_segment_id;
 
-    const SegmentMeta& meta = m_index_reader.GetMeta();
-    m_max_key = meta.max_key;
-    m_max_object_id = meta.max_object_id;
-    
-    return s;
+    m_max_key = m_meta.max_key;
+    m_max_object_id = m_meta.max_object_id;
+
+	if(!table)
+	{
+		return OK;
+	}
+	if(!m_use_table_cache)
+	{
+		m_table = table;
+		m_table_opened.store(true, std::memory_order_release);
+	}
+	else
+	{
+		//刚打开的segment通常马上会被读，放入表缓存
+		m_table_wptr = table;
+		engine->GetTableCache().Add(this, table, table->FileNum());
+	}
+    return OK;
+}
+
+SegmentTablePtr SegmentReader::GetTable() const
+{
+	if(m_table_opened.load(std::memory_order_acquire))
+	{
+		return m_table;
+	}
+
+	if(!m_use_table_cache)
+	{
+		//延迟打开，打开后常驻
+		std::lock_guard<std::mutex> lock(m_table_mutex);
+		if(!m_table)
+		{
+			SegmentTablePtr table = NewSegmentTable();
+			Status s = table->Open(m_bucket_path.c_str(), m_segment_stat);
+			if(s != OK)
+			{
+				LogWarn("open segment(id=%ld) of bucket(%s) failed, status: %u", m_segment_stat.segment_fileid, m_bucket_path.c_str(), s);
+				return table;
+			}
+			m_table = table;
+			m_table_opened.store(true, std::memory_order_release);
+		}
+		return m_table;
+	}
+
+	auto& cache = Engine::GetEngine()->GetTableCache();
+	SegmentTablePtr table;
+	if(cache.Get(this, table))
+	{
+		return table;
+	}
+
+	std::lock_guard<std::mutex> lock(m_table_mutex);
+	if(cache.Get(this, table))
+	{
+		return table;
+	}
+	//已被淘汰，但可能仍在被迭代器使用
+	table = m_table_wptr.lock();
+	if(!table)
+	{
+		table = NewSegmentTable();
+		Status s = table->Open(m_bucket_path.c_str(), m_segment_stat);
+		if(s != OK)
+		{
+			LogWarn("reopen segment(id=%ld) of bucket(%s) failed, status: %u", m_segment_stat.segment_fileid, m_bucket_path.c_str(), s);
+			return table;
+		}
+		m_table_wptr = table;
+	}
+	cache.Add(this, table, table->FileNum());
+	return table;
 }
 
 Status SegmentReader::Get(const StrView& key, objectid_t obj_id, ObjectType& type, std::string& value) const
 {
+	//按bucket meta中的key范围过滤，不在范围内时无需打开index文件
+	if(key.Compare(MinKey()) < 0 || key.Compare(m_max_key) > 0)
+	{
+		return ERR_OBJECT_NOT_EXIST;
+	}
+	SegmentTablePtr table = GetTable();
+	if(!table->opened)
+	{
+		return ERR_FILE_READ;
+	}
+
 	SegmentL0Index L0index;
-	Status s = m_index_reader.Search(key, L0index);
+	Status s = table->index_reader.Search(key, L0index);
 	if(s != OK)
 	{
 		return s;
 	}
 	assert(L0index.start_key.Empty());
-	return m_data_reader.Search(L0index, key, type, value);
+	return table->data_reader.Search(L0index, key, type, value);
 }
 
 IteratorImplPtr SegmentReader::NewIterator(objectid_t max_object_id)
@@ -72,6 +207,22 @@ IteratorImplPtr SegmentReader::NewIterator(objectid_t max_object_id)
 	return NewSegmentReaderIterator(ptr);
 }
 
+IteratorImplPtr SegmentReader::NewMergeIterator(bool drop_cache)
+{
+	SegmentReaderPtr ptr = std::dynamic_pointer_cast<SegmentReader>(shared_from_this());
+
+	return NewSegmentReaderIterator(ptr, false, drop_cache);
+}
+
+void SegmentReader::SampleKeys(size_t max_num, std::vector<std::string>& keys) const
+{
+	SegmentTablePtr table = GetTable();
+	if(table->opened)
+	{
+		table->index_reader.SampleKeys(max_num, keys);
+	}
+}
+
 uint64_t SegmentReader::Size() const
 {
 	return m_segment_stat.index_filesize + m_segment_stat.data_filesize;
@@ -80,30 +231,77 @@ uint64_t SegmentReader::Size() const
 void SegmentReader::GetBucketStat(BucketStat& stat) const
 {
 	stat.segment_stat.Add(Size());
-	stat.object_stat.Add(m_index_reader.GetMeta().object_stat);
+	stat.object_stat.Add(m_segment_stat.object_stat);
 }
 
 // /////////////////////////////////////////////////////////////////////////////////////////////
-SegmentReaderIterator::SegmentReaderIterator(SegmentReaderPtr& segment_reader) 
+SegmentReaderIterator::SegmentReaderIterator(SegmentReaderPtr& segment_reader, bool fill_cache, bool drop_cache) 
+	: SegmentReaderIterator(segment_reader, segment_reader->GetTable(), fill_cache, drop_cache)
+{
+}
+
+SegmentReaderIterator::SegmentReaderIterator(SegmentReaderPtr& segment_reader, const SegmentTablePtr& table, bool fill_cache, bool drop_cache) 
  	: m_segment_reader(segment_reader), 
-      m_L1index_count(segment_reader->m_index_reader.m_L1indexs.size()),
-	  m_index_block_reader(segment_reader->m_index_reader),
-	  m_data_block_reader(segment_reader->m_data_reader.m_file, segment_reader->m_data_reader.m_path)
+	  m_table(table),
+      m_L1index_count(table->index_reader.m_L1indexs.size()),
+	  m_index_block_reader(table->index_reader),
+	  m_data_block_reader(table->data_reader, fill_cache),
+	  m_drop_cache(drop_cache),
+	  m_max_readahead_size(Engine::GetEngine()->GetConfig().max_readahead_size)
 {
     m_max_key = m_segment_reader->MaxKey();
     assert(m_max_key.size != 0);    
     
     m_max_object_id = m_segment_reader->MaxObjectID();
+	m_dropped_offset = 0;
+	m_readahead_size = 0;
+	m_next_block_offset = 0;
+	m_readahead_offset = 0;
+	m_prefetched_L1index_idx = 0;
 
 	First();
 }
 
+SegmentReaderIterator::~SegmentReaderIterator()
+{
+	if(m_drop_cache)
+	{
+		m_table->data_reader.m_file->DropCache(m_dropped_offset, 0);
+	}
+}
+
+Status SegmentReaderIterator::ReadDataBlock()
+{
+	const SegmentL0Index& L0_index = m_index_block_iter->L0Index();
+	Status s = m_data_block_reader.Read(L0_index);
+	if(s != OK)
+	{
+		return s;
+	}
+	m_data_block_iter = m_data_block_reader.NewIterator();
+	Readahead(L0_index);
+
+	//顺序读时之前的块已不再需要，攒够一定大小后再丢弃，减少系统调用
+	constexpr uint64_t DROP_CACHE_SIZE = 1024*1024;
+	if(m_drop_cache && L0_index.L0offset >= m_dropped_offset + DROP_CACHE_SIZE)
+	{
+		m_table->data_reader.m_file->DropCache(m_dropped_offset, L0_index.L0offset - m_dropped_offset);
+		m_dropped_offset = L0_index.L0offset;
+	}
+	return OK;
+}
+
 Status SegmentReaderIterator::SeekL1Index(size_t idx, const StrView* key)
 {
     m_L1index_idx = idx;
     m_data_block_iter.reset();
+	if(m_L1index_count == 0)
+	{
+		//table打开失败
+		return ERR_FILE_READ;
+	}
 
-	Status s = m_index_block_reader.Read(m_segment_reader->m_index_reader.m_L1indexs[idx]);
+	Status s = m_index_block_reader.Read(m_table->index_reader.m_L1indexs[idx]);
     if(s != OK)
     {
         return s;
@@ -114,12 +312,11 @@ Status SegmentReaderIterator::SeekL1Index(size_t idx, const StrView* key)
         m_index_block_iter->Seek(*key);
     }
 
-	s = m_data_block_reader.Read(m_index_block_iter->L0Index());
+	s = ReadDataBlock();
     if(s != OK)
     {
         return s;
     }
-	m_data_block_iter = m_data_block_reader.NewIterator();
     if(key != nullptr)
     {
         m_data_block_iter->Seek(*key);
@@ -138,6 +335,73 @@ Status SegmentReaderIterator::SeekL1Index(size_t idx, const StrView* key)
 	return OK;
 }
 
+//连续读取相邻的data block时认为是顺序读，异步预读后续的块，命中预读后窗口翻倍直到m_max_readahead_size
+void SegmentReaderIterator::Readahead(const SegmentL0Index& L0_index)
+{
+	constexpr uint32_t MIN_READAHEAD_SIZE = 64*1024;
+	if(m_max_readahead_size == 0)
+	{
+		return;
+	}
+
+	//单文件segment中data块之间夹着L1 index块，跳过不大的间隔仍视为顺序读
+	bool sequential = (L0_index.L0offset >= m_next_block_offset && L0_index.L0offset - m_next_block_offset < MIN_READAHEAD_SIZE);
+	m_next_block_offset = L0_index.L0offset + L0_index.L0compress_size;
+	if(!sequential)
+	{
+		//Seek等随机读不预读
+		m_readahead_size = 0;
+		m_readahead_offset = m_next_block_offset;
+		return;
+	}
+	if(m_readahead_size == 0)
+	{
+		m_readahead_size = MIN(MIN_READAHEAD_SIZE, m_max_readahead_size);
+	}
+
+	//已预读的数据消耗过半时再发起下一次预读
+	if(m_readahead_offset < m_next_block_offset)
+	{
+		m_readahead_offset = m_next_block_offset;
+	}
+	if(m_readahead_offset - m_next_block_offset >= m_readahead_size / 2)
+	{
+		return;
+	}
+	//映射区设置了MADV_RANDOM，顺序读时需显式预读
+	const DataReader& data_reader = m_table->data_reader;
+	if(data_reader.m_mapping->Mapped())
+	{
+		data_reader.m_mapping->Advise(m_readahead_offset, m_readahead_size, MADV_WILLNEED);
+	}
+	else
+	{
+		data_reader.m_file->Prefetch(m_readahead_offset, m_readahead_size);
+	}
+	m_readahead_offset += m_readahead_size;
+	m_readahead_size = MIN(m_readahead_size * 2, m_max_readahead_size);
+
+	PrefetchL1Index(m_L1index_idx + 1);
+}
+
+void SegmentReaderIterator::PrefetchL1Index(size_t idx)
+{
+	if(idx < m_L1index_count && idx > m_prefetched_L1index_idx)
+	{
+		m_prefetched_L1index_idx = idx;
+		const IndexReader& index_reader = m_table->index_reader;
+		const SegmentL1Index& L1_index = index_reader.m_L1indexs[idx];
+		if(index_reader.m_mapping.Mapped())
+		{
+			index_reader.m_mapping.Advise(L1_index.L1offset, L1_index.L1compress_size, MADV_WILLNEED);
+		}
+		else
+		{
+			index_reader.m_file.Prefetch(L1_index.L1offset, L1_index.L1compress_size);
+		}
+	}
+}
+
 /**移到第1个元素处*/
 void SegmentReaderIterator::First()
 {
@@ -153,7 +417,11 @@ void SegmentReaderIterator::First()
 void SegmentReaderIterator::Seek(const StrView& key)
 {
     m_data_block_iter.reset();
-    ssize_t idx = m_segment_reader->m_index_reader.Find(key);
+	if(m_L1index_count == 0)
+	{
+		return;
+	}
+    ssize_t idx = m_table->index_reader.Find(key);
     if(idx < 0)
     {
         return;
@@ -192,30 +460,19 @@ Status SegmentReaderIterator::Next_()
 	m_index_block_iter->Next();
 	if(m_index_block_iter->Valid())
 	{
-		Status s = m_data_block_reader.Read(m_index_block_iter->L0Index());
-        if(s != OK)
-        {
-            return s;
-        }
-		m_data_block_iter = m_data_block_reader.NewIterator();
-		return OK;
+		return ReadDataBlock();
 	}
 
 	if(++m_L1index_idx < m_L1index_count)
 	{
-		Status s = m_index_block_reader.Read(m_segment_reader->m_index_reader.m_L1indexs[m_L1index_idx]);
+		Status s = m_index_block_reader.Read(m_table->index_reader.m_L1indexs[m_L1index_idx]);
         if(s != OK)
         {
             return s;
         }
 		m_index_block_iter = m_index_block_reader.NewIterator();
 
-		s = m_data_block_reader.Read(m_index_block_iter->L0Index());
-        if(s != OK)
-        {
-            return s;
-        }
-		m_data_block_iter = m_data_block_reader.NewIterator();
+		return ReadDataBlock();
 	}
     return OK;
 }
@@ -228,28 +485,41 @@ bool SegmentReaderIterator::Valid() const
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 SegmentWriter::SegmentWriter(const BucketConfig& bucket_conf, BlockPool& pool)
-	: m_index_writer(bucket_conf, pool), m_data_writer(bucket_conf, pool, m_index_writer)
+	: m_bucket_conf(bucket_conf), m_index_writer(bucket_conf, pool), m_data_writer(bucket_conf, pool, m_index_writer)
 {
     m_max_merge_segment_id = MIN_FILE_ID;
+	m_bypass_cache = false;
 }
 
 SegmentWriter::~SegmentWriter()
 {
 }
 
-Status SegmentWriter::Create(const char* bucket_path, fileid_t fileid)
+Status SegmentWriter::Create(const char* bucket_path, fileid_t fileid, uint64_t expected_size, bool bypass_cache)
 {
     m_max_merge_segment_id = SEGMENT_ID(fileid);
+	m_bypass_cache = bypass_cache;
     
+	if(Engine::GetEngine()->GetConfig().single_file_segment)
+	{
+		Status s = m_index_writer.Create(bucket_path, fileid, true, expected_size, bypass_cache);
+		if(s != OK)
+		{
+			return s;
+		}
+		m_data_writer.Create();
+		return OK;
+	}
+
 	Status s = m_index_writer.Create(bucket_path, fileid);
 	if(s != OK)
 	{
 		return s;
 	}
-	return m_data_writer.Create(bucket_path, fileid);
+	return m_data_writer.Create(bucket_path, fileid, expected_size, bypass_cache);
 }
 
-Status SegmentWriter::Write(IteratorImplPtr& iter, const BucketStat& stat, SegmentStat& seg_stat)
+Status SegmentWriter::Write(IteratorImplPtr& iter, SegmentStat& seg_stat)
 {	
 	Status s = m_data_writer.Write(*iter);
 	if(s != OK)
@@ -263,7 +533,7 @@ Status SegmentWriter::Write(IteratorImplPtr& iter, const BucketStat& stat, Segme
 	}
 
 	SegmentMeta meta;
-	meta.object_stat = stat.object_stat;
+	meta.object_stat = m_data_writer.m_stat;
     meta.max_key = iter->MaxKey();
     meta.max_object_id = iter->MaxObjectID();
     meta.max_merge_segment_id = m_max_merge_segment_id;
@@ -276,6 +546,11 @@ Status SegmentWriter::Write(IteratorImplPtr& iter, const BucketStat& stat, Segme
 	seg_stat.data_filesize = m_data_writer.FileSize();
 	seg_stat.index_filesize = m_index_writer.FileSize();
 	seg_stat.L2index_meta_size = m_index_writer.L2IndexMetaSize();
+	seg_stat.min_key = m_index_writer.MinKey();
+	seg_stat.max_key.assign(meta.max_key.data, meta.max_key.size);
+	seg_stat.max_object_id = meta.max_object_id;
+	seg_stat.max_merge_segment_id = meta.max_merge_segment_id;
+	seg_stat.object_stat = meta.object_stat;
 	return OK;
 }
 
@@ -284,10 +559,7 @@ Status SegmentWriter::Write(const ObjectWriterSnapshotPtr& object_writer_snapsho
 	//FIXME:与Merge相似，可以合并
 	IteratorImplPtr iter = object_writer_snapshot->NewIterator();
 
-	BucketStat stat = {0};
-	object_writer_snapshot->GetBucketStat(stat);
-
-	return Write(iter, stat, seg_stat);
+	return Write(iter, seg_stat);
 }
 
 Status SegmentWriter::Write(const MergingSegmentInfo& msinfo, SegmentStat& seg_stat)
@@ -296,16 +568,83 @@ Status SegmentWriter::Write(const MergingSegmentInfo& msinfo, SegmentStat& seg_s
 	msinfo.GetMergingReaders(segment_readers);
     m_max_merge_segment_id = SEGMENT_ID(segment_readers.rbegin()->first);
 
-    BucketMetaFilePtr meta_file;
-	ObjectReaderSnapshot tmp_reader_snapshot(meta_file, segment_readers);
-	IteratorImplPtr iter = tmp_reader_snapshot.NewIterator();
-
-	BucketStat stat = {0};
-	tmp_reader_snapshot.GetBucketStat(stat);
+	IteratorImplPtr iter;
+	if(segment_readers.size() == 1)
+	{
+		iter = NewRewriteIterator(msinfo);
+	}
+	else
+	{
+		//由新到老存放
+		std::vector<IteratorImplPtr> iters;
+		iters.reserve(segment_readers.size());
+		for(auto it = segment_readers.rbegin(); it != segment_readers.rend(); ++it)
+		{
+			iters.push_back(NewInputIterator(it->second));
+		}
+		iter = NewIteratorSet(iters);
+	}
+	if(msinfo.IsBottomMerge())
+	{
+		iter = NewDeleteFilterIterator(iter);
+	}
+	if(m_bucket_conf.compaction_filter)
+	{
+		//最底层时被过滤的对象直接丢弃，否则需保留删除标记
+		iter = NewCompactionFilterIterator(iter, m_bucket_conf.compaction_filter, false, msinfo.IsBottomMerge());
+	}
     
-	return Write(iter, stat, seg_stat);
+	return Write(iter, seg_stat);
 }
 		
+IteratorImplPtr SegmentWriter::NewInputIterator(const ObjectReaderPtr& reader)
+{
+	SegmentReaderPtr segment_reader = std::dynamic_pointer_cast<SegmentReader>(reader);
+	return segment_reader ? segment_reader->NewMergeIterator(m_bypass_cache) : reader->NewIterator();
+}
+
+//重写单个segment：过滤掉被更新的segment覆盖的object
+IteratorImplPtr SegmentWriter::NewRewriteIterator(const MergingSegmentInfo& msinfo)
+{
+	const auto& readers = msinfo.reader_snapshot->Readers();
+	fileid_t fileid = *msinfo.merging_segment_fileids.begin();
+
+	auto it = readers.find(fileid);
+	assert(it != readers.end());
+	SegmentReaderPtr segment_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+	assert(segment_reader);
+	
+	const StrView min_key = segment_reader->MinKey();
+	const StrView& max_key = segment_reader->MaxKey();
+
+	//重写后的segment已不包含被覆盖的object，记录已检查的最大segment id，后续只需检查更新的segment
+	m_max_merge_segment_id = segment_reader->MaxMergeSegmentID();
+
+	//只需检查key范围有重叠的segment，由新到老存放，与待重写的segment一起顺序读取
+	std::vector<IteratorImplPtr> newer_iters;
+	for(auto rit = readers.rbegin(); rit != readers.rend() && rit->first > fileid; ++rit)
+	{
+		SegmentReaderPtr newer_reader = std::dynamic_pointer_cast<SegmentReader>(rit->second);
+		fileid_t max_segment_id = newer_reader ? newer_reader->MaxMergeSegmentID() : SEGMENT_ID(rit->first);
+		m_max_merge_segment_id = MAX(m_max_merge_segment_id, max_segment_id);
+
+		if(newer_reader && (newer_reader->MaxKey().Compare(min_key) < 0 || newer_reader->MinKey().Compare(max_key) > 0))
+		{
+			continue;
+		}
+		//更新的segment仍在使用，不丢弃其page cache
+		newer_iters.push_back(newer_reader ? newer_reader->NewMergeIterator(false) : rit->second->NewIterator());
+	}
+
+	IteratorImplPtr iter = NewInputIterator(segment_reader);
+	if(newer_iters.empty())
+	{
+		return iter;
+	}
+	IteratorImplPtr newer_iter = (newer_iters.size() == 1) ? newer_iters[0] : NewIteratorSet(newer_iters);
+	return NewShadowFilterIterator(iter, newer_iter);
+}
+
 Status SegmentWriter::Remove(const char* bucket_path, fileid_t fileid)
 {
 	Status s = IndexWriter::Remove(bucket_path, fileid);
@@ -319,18 +658,42 @@ Status SegmentWriter::Remove(const char* bucket_path, fileid_t fileid)
 
 fileid_t MergingSegmentInfo::NewSegmentFileID() const
 {
-	//算法：选用最小的seqid，将其merge count+1
-	assert(merging_segment_fileids.size() > 1);
+	//算法：选用最小的seqid，将其merge count+1；单个segment重写时见RewriteSegmentFileID
+	//同一segment id的merge count只增不减，因此新fileid不会与已删除或待删除的segment相同
+	assert(!merging_segment_fileids.empty());
 	fileid_t fileid = *merging_segment_fileids.begin();
+	if(merging_segment_fileids.size() == 1)
+	{
+		return RewriteSegmentFileID(fileid);
+	}
 	
     uint16_t new_merge_count = MERGE_COUNT(fileid) + 1;
-    assert(new_merge_count <= MAX_MERGE_COUNT);
+	if(new_merge_count > MAX_MERGE_COUNT)
+	{
+		return INVALID_FILE_ID;
+	}
 
 	fileid_t segment_id = SEGMENT_ID(fileid);
 
     return SEGMENT_FILEID(segment_id, new_merge_count);
 }
 
+bool MergingSegmentInfo::IsBottomMerge() const
+{
+	assert(reader_snapshot);
+	const auto& readers = reader_snapshot->Readers();
+
+	fileid_t max_fileid = *merging_segment_fileids.rbegin();
+	for(auto it = readers.begin(); it != readers.end() && it->first < max_fileid; ++it)
+	{
+		if(merging_segment_fileids.find(it->first) == merging_segment_fileids.end())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 void MergingSegmentInfo::GetMergingReaders(std::map<fileid_t, ObjectReaderPtr>& segment_readers) const
 {
 	assert(reader_snapshot);
@@ -17,6 +17,7 @@ limitations under the License.
 #ifndef __xfdb_segment_file_h__
 #define __xfdb_segment_file_h__
 
+#include <atomic>
 #include "db_types.h"
 #include "data_file.h"
 #include "index_file.h"
@@ -29,6 +30,22 @@ limitations under the License.
 namespace xfdb 
 {
 
+//segment打开的文件及解析出的L1 index，max_open_files非0时由表缓存管理，可被关闭后按需重新打开
+struct SegmentTable
+{
+	IndexReader index_reader;
+	DataReader data_reader;
+	bool opened = false;
+
+	Status Open(const char* bucket_path, const SegmentStat& info);
+
+	//打开的文件数，用于表缓存计数
+	inline uint32_t FileNum() const
+	{
+		return index_reader.IsSingleFile() ? 1 : 2;
+	}
+};
+
 class SegmentReader : public ObjectReader
 {
 public:
@@ -36,11 +53,17 @@ public:
 	virtual ~SegmentReader();
 
 public:
-	Status Open(const char* bucket_path, const SegmentStat& info);
+	/**lazy为true且info中有key范围时，不打开文件，首次读时再打开*/
+	Status Open(const char* bucket_path, const SegmentStat& info, bool lazy = false);
 	
 	Status Get(const StrView& key, objectid_t obj_id, ObjectType& type, std::string& value) const override;
 	
 	IteratorImplPtr NewIterator(objectid_t max_object_id = MAX_OBJECT_ID) override;
+	/**merge等后台读取使用的迭代器，读过的块不加入data cache，drop_cache为true时同时丢弃page cache*/
+	IteratorImplPtr NewMergeIterator(bool drop_cache);
+
+	/**均匀抽取约max_num个key，用于估算与其他segment的重叠比例*/
+	void SampleKeys(size_t max_num, std::vector<std::string>& keys) const;
 
 	/**返回segment文件总大小*/
 	uint64_t Size() const override;
@@ -51,11 +74,32 @@ public:
 	{
 		return m_segment_stat;
 	}
-	
+	//最小key
+	inline StrView MinKey() const
+	{
+		return StrView(m_segment_stat.min_key);
+	}
+	//已合并（或重写时已检查）的最大segment id
+	inline fileid_t MaxMergeSegmentID() const
+	{
+		return m_meta.max_merge_segment_id;
+	}
+
+	/**返回打开的table，已被表缓存关闭时重新打开；打开失败时返回opened为false的空table*/
+	SegmentTablePtr GetTable() const;
+
 private:
+	std::string m_bucket_path;
 	SegmentStat m_segment_stat;
-	IndexReader m_index_reader;
-	DataReader m_data_reader;
+
+	//table关闭后仍需使用的元数据，key范围和object统计保存在m_segment_stat中
+	SegmentMeta m_meta;
+	bool m_use_table_cache;			//max_open_files不为0
+
+	mutable SegmentTablePtr m_table;		//max_open_files为0时常驻，延迟打开时首次读才设置
+	mutable std::atomic<bool> m_table_opened;
+	mutable std::mutex m_table_mutex;
+	mutable std::weak_ptr<SegmentTable> m_table_wptr;	//被表缓存淘汰后可能仍被迭代器使用
 	
 private:
 	friend class SegmentReaderIterator;
@@ -67,9 +111,10 @@ private:
 class SegmentReaderIterator : public IteratorImpl 
 {
 public:
-	explicit SegmentReaderIterator(SegmentReaderPtr& segment_reader);
-	virtual ~SegmentReaderIterator()
-	{}
+	//fill_cache: 读过的块是否加入data cache，后台读取时不加入；drop_cache: 丢弃读过的page cache，用于merge
+	explicit SegmentReaderIterator(SegmentReaderPtr& segment_reader, bool fill_cache = true, bool drop_cache = false);
+	SegmentReaderIterator(SegmentReaderPtr& segment_reader, const SegmentTablePtr& table, bool fill_cache, bool drop_cache);
+	virtual ~SegmentReaderIterator();
 
 public:
 	/**移到第1个元素处*/
@@ -87,12 +132,16 @@ public:
 private:
     Status SeekL1Index(size_t idx, const StrView* key = nullptr);  
 	Status Next_();
+	Status ReadDataBlock();
+	void Readahead(const SegmentL0Index& L0_index);
+	void PrefetchL1Index(size_t idx);
 	inline bool Valid_() const
     {
         return (m_data_block_iter && m_data_block_iter->Valid());
     }
 private:
 	SegmentReaderPtr m_segment_reader;
+	SegmentTablePtr m_table;		//迭代期间保持文件打开
 	const size_t m_L1index_count;
     
 	size_t m_L1index_idx;
@@ -101,6 +150,15 @@ private:
 	DataBlockReader m_data_block_reader;
 	DataBlockReaderIteratorPtr m_data_block_iter;
 
+	const bool m_drop_cache;
+	uint64_t m_dropped_offset;		//此偏移之前的page cache已丢弃
+
+	const uint32_t m_max_readahead_size;
+	uint32_t m_readahead_size;		//当前预读窗口，0表示未检测到顺序读
+	uint64_t m_next_block_offset;	//顺序读时下一个data block的偏移
+	uint64_t m_readahead_offset;	//已发起预读的data文件偏移
+	size_t m_prefetched_L1index_idx;	//已发起预读的L1 index块
+
 private:
 	SegmentReaderIterator(const SegmentReaderIterator&) = delete;
 	SegmentReaderIterator& operator=(const SegmentReaderIterator&) = delete;
@@ -113,7 +171,9 @@ public:
 	~SegmentWriter();
 	
 public:	
-	Status Create(const char* bucket_path, fileid_t fileid);
+	//expected_size: 预计的segment大小，用于预分配data文件空间，0表示不预分配
+	//bypass_cache: 读写data文件时不占用page cache，用于merge
+	Status Create(const char* bucket_path, fileid_t fileid, uint64_t expected_size = 0, bool bypass_cache = false);
 	
 	Status Write(const ObjectWriterSnapshotPtr& object_writer_snapshot, SegmentStat& seg_stat);
 	Status Write(const MergingSegmentInfo& msinfo, SegmentStat& seg_stat);
@@ -121,10 +181,14 @@ public:
 	static Status Remove(const char* bucket_path, fileid_t fileid);
 
 private:
-	Status Write(IteratorImplPtr& iter, const BucketStat& stat, SegmentStat& seg_stat);
+	Status Write(IteratorImplPtr& iter, SegmentStat& seg_stat);
+	IteratorImplPtr NewRewriteIterator(const MergingSegmentInfo& msinfo);
+	IteratorImplPtr NewInputIterator(const ObjectReaderPtr& reader);
 
 private:
+	const BucketConfig& m_bucket_conf;
     fileid_t m_max_merge_segment_id;
+	bool m_bypass_cache;
 	IndexWriter m_index_writer;
 	DataWriter m_data_writer;
 
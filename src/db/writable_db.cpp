@@ -54,7 +54,7 @@ BucketPtr WritableDB::NewBucket(const BucketInfo& bucket_info)
 	return NewWriteOnlyBucket((WritableEngine*)engine.get(), shared_from_this(), bucket_info);
 }
 
-Status WritableDB::Remove(const std::string& db_path)
+Status WritableDB::Remove(const std::string& db_path, const DBConfig& dbconf)
 {
 	//获取写锁
 	{
@@ -77,11 +77,11 @@ Status WritableDB::Remove(const std::string& db_path)
 			{
 				return s;
 			}
-			char bucket_path[MAX_PATH_LEN];
+			std::vector<std::string> segment_paths;
 			for(const auto bi : dm.deleted_buckets)
 			{
-				MakeBucketPath(db_path.c_str(), bi.name.c_str(), bi.id, bucket_path);
-				s = WriteOnlyBucket::Remove(bucket_path);
+				MakeSegmentPaths(db_path.c_str(), dbconf.data_paths, bi.name.c_str(), bi.id, segment_paths);
+				s = WriteOnlyBucket::Remove(segment_paths);
 				if(s != OK)
 				{
 					return s;
@@ -92,8 +92,8 @@ Status WritableDB::Remove(const std::string& db_path)
 			{
 				for(const auto bi : dm.alive_buckets)
 				{
-					MakeBucketPath(db_path.c_str(), bi.name.c_str(), bi.id, bucket_path);
-					s = WriteOnlyBucket::Remove(bucket_path);
+					MakeSegmentPaths(db_path.c_str(), dbconf.data_paths, bi.name.c_str(), bi.id, segment_paths);
+					s = WriteOnlyBucket::Remove(segment_paths);
 					if(s != OK)
 					{
 						return s;
@@ -103,6 +103,12 @@ Status WritableDB::Remove(const std::string& db_path)
 		}
 	}
 
+	char path[MAX_PATH_LEN];
+	for(const auto& dp : dbconf.data_paths)
+	{
+		Path::Combine(path, sizeof(path), dp.path.c_str(), Path::GetFileName(db_path.c_str()));
+		Directory::Remove(path);
+	}
 	Directory::Remove(db_path.c_str());
 	return OK;
 }
@@ -198,7 +204,7 @@ Status WritableDB::CleanDBMeta()
 			clean_filename = m_tobe_delete_dbmeta_files.front();
 		}
 		
-		Status s = DBMetaFile::Remove(m_path.c_str(), clean_filename.str);
+		Status s = DBMetaFile::Remove(m_path.c_str(), clean_filename.str, m_conf.data_paths);
 		if(s != OK)
 		{
 			return s;
@@ -538,6 +544,19 @@ Status WritableDB::Merge()
 	return OK;
 }
 
+Status WritableDB::CheckCompaction(bool bottom_rewrite)
+{
+	m_bucket_rwlock.ReadLock();
+	BucketSetPtr bucket_set = m_bucket_set;
+	m_bucket_rwlock.ReadUnlock();
+
+	if(bucket_set)
+	{
+		bucket_set->CheckCompaction(bottom_rewrite);
+	}
+	return OK;
+}
+
 Status WritableDB::Merge(const std::string& bucket_name)
 {
 	BucketPtr bptr;
@@ -548,6 +567,16 @@ Status WritableDB::Merge(const std::string& bucket_name)
 	return bptr->Merge();
 }
 
+Status WritableDB::Merge(const std::string& bucket_name, const StrView& start_key, const StrView& end_key)
+{
+	BucketPtr bptr;
+	if(!GetBucket(bucket_name, bptr))
+	{
+		return ERR_BUCKET_NOT_EXIST;
+	}
+	return bptr->Merge(start_key, end_key);
+}
+
 void WritableDB::WriteDBMeta(DBMeta& dm)
 {
 	//已经获取到锁
@@ -41,7 +41,7 @@ public:
 	Status Open() override;
 	
 	//删除db数据，删除前请先close db
-	static Status Remove(const std::string& db_path);
+	static Status Remove(const std::string& db_path, const DBConfig& dbconf);
 	
 	//bucket api
 	Status CreateBucket(const std::string& bucket_name) override;	
@@ -63,6 +63,7 @@ public:
 
 	Status Merge() override;		//将所有的block表合并成最大block(异步)
 	Status Merge(const std::string& bucket_name) override;
+	Status Merge(const std::string& bucket_name, const StrView& start_key, const StrView& end_key) override;
 	
 protected:	
 	BucketPtr NewBucket(const BucketInfo& bucket_info) override;
@@ -75,6 +76,7 @@ private:
 	Status Write(const std::string& bucket_name, const Object* object);
 		
 	Status Clean();
+	Status CheckCompaction(bool bottom_rewrite);
 	Status CleanBucket();
 
 	Status CleanDBMeta();
@@ -22,6 +22,7 @@ limitations under the License.
 #include "writable_db.h"
 #include "writeonly_bucket.h"
 #include "notify_file.h"
+#include "rate_limiter.h"
 
 namespace xfdb 
 {
@@ -53,6 +54,15 @@ Status WritableEngine::Start_()
 
 	ScanNotifyFile();
 
+	if(m_conf.shm_notify && !m_conf.notify_dir.empty())
+	{
+		Status s = m_notify_ring.Open(m_conf.notify_dir.c_str(), true);
+		if(s != OK)
+		{
+			LogWarn("open notify ring in %s failed, use notify file, status: %d", m_conf.notify_dir.c_str(), s);
+		}
+	}
+
 	return OK;
 }
  
@@ -65,7 +75,7 @@ void WritableEngine::Stop_()
 
 	for(size_t i = 0; i < m_conf.part_merge_thread_num; ++i)
 	{
-		m_part_merge_queue.Push(msg);
+		m_part_merge_scheduler.Push(msg);
 	}
 	m_part_merge_threadgroup.Join();
 
@@ -92,14 +102,20 @@ void WritableEngine::Stop_()
 	delete[] m_write_metadata_queues;
 }
 
+Status WritableEngine::GetMergeQueueStat(MergeQueueStat& stat)
+{
+	m_part_merge_scheduler.GetStat(stat);
+	return OK;
+}
+
 DBImplPtr WritableEngine::NewDB(const DBConfig& conf, const std::string& db_path)
 {
 	return NewWritableDB(conf, db_path);
 }
 
-Status WritableEngine::RemoveDB(const std::string& db_path)
+Status WritableEngine::RemoveDB(const std::string& db_path, const DBConfig& dbconf)
 {
-	return WritableDB::Remove(db_path);
+	return WritableDB::Remove(db_path, dbconf);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -112,10 +128,12 @@ void WritableEngine::PartMergeThread(size_t index, void* arg)
 	
 	assert(index < engine->m_conf.part_merge_thread_num);
 	
+	IOPriorityGuard io_guard(IO_PRIORITY_MID);
+
 	for(;;)
 	{
 		NotifyMsg msg;
-		engine->m_part_merge_queue.Pop(msg);
+		engine->m_part_merge_scheduler.Pop(msg);
 		if(msg.type == NOTIFY_EXIT) 
 		{
 			break;
@@ -123,10 +141,11 @@ void WritableEngine::PartMergeThread(size_t index, void* arg)
 		assert(msg.type == NOTIFY_PART_MERGE);
 		WriteOnlyBucket* bucket = (WriteOnlyBucket*)msg.bucket.get();
 		Status s = bucket->PartMerge();
-        if(s != OK)
+        if(s != OK && s != ERR_NOMORE_DATA)
         {
             LogWarn("part merge for %s failed, status: %u", bucket->Info().name.c_str(), s);
         }
+		engine->m_part_merge_scheduler.Done(msg);
 	}
 	LogDebug("the %dst part merge thread exit", index);	
 }
@@ -140,6 +159,8 @@ void WritableEngine::FullMergeThread(size_t index, void* arg)
 	
 	assert(index < engine->m_conf.full_merge_thread_num);
 	
+	IOPriorityGuard io_guard(IO_PRIORITY_MID);
+
 	for(;;)
 	{
 		NotifyMsg msg;
@@ -148,9 +169,26 @@ void WritableEngine::FullMergeThread(size_t index, void* arg)
 		{
 			break;
 		}
-		assert(msg.type == NOTIFY_FULL_MERGE);
 		WriteOnlyBucket* bucket = (WriteOnlyBucket*)msg.bucket.get();
-        Status s = bucket->FullMerge();
+		if(msg.type == NOTIFY_BOTTOM_REWRITE)
+		{
+			Status s = bucket->BottomRewrite();
+			if(s != OK && s != ERR_NOMORE_DATA && s != ERR_IN_PROCESSING)
+			{
+				LogWarn("bottom rewrite for %s failed, status: %u", bucket->Info().name.c_str(), s);
+			}
+			continue;
+		}
+		Status s;
+		if(msg.type == NOTIFY_RANGE_MERGE)
+		{
+			s = bucket->RangeMerge();
+		}
+		else
+		{
+			assert(msg.type == NOTIFY_FULL_MERGE);
+			s = bucket->FullMerge();
+		}
 		if(s == ERR_IN_PROCESSING)
 		{
 			Thread::Sleep(10*1000);
@@ -158,9 +196,9 @@ void WritableEngine::FullMergeThread(size_t index, void* arg)
 			//重新放入合并队列
 			engine->m_full_merge_queue.TryPush(msg);
 		}
-        else if(s != OK)
+        else if(s != OK && s != ERR_NOMORE_DATA)
         {
-            LogWarn("full merge for %s failed, status: %u", bucket->Info().name.c_str(), s);
+            LogWarn("%s merge for %s failed, status: %u", (msg.type == NOTIFY_RANGE_MERGE) ? "range" : "full", bucket->Info().name.c_str(), s);
         }
 	}
 	LogDebug("the %dst full merge thread started", index);
@@ -215,6 +253,8 @@ void WritableEngine::WriteSegmentThread(size_t index, void* arg)
 	WritableEngine* engine = (WritableEngine*)arg;
 	assert(engine != nullptr);
 
+	IOPriorityGuard io_guard(IO_PRIORITY_HIGH);
+
 	for(;;)
 	{
 		NotifyMsg msg;
@@ -333,6 +373,11 @@ void WritableEngine::WriteNotifyFile(const NotifyData& nd)
 		return;
 	}
 
+	if(m_notify_ring.Opened() && m_notify_ring.Write(nd) == OK)
+	{
+		return;
+	}
+
 	FileName filename;
 	if(NotifyFile::Write(m_conf.notify_dir.c_str(), nd, filename) == OK)
 	{
@@ -407,6 +452,29 @@ void WritableEngine::CleanDB(std::set<std::string>& clean_dbs)
 	}
 }
 
+void WritableEngine::CheckCompaction(bool bottom_rewrite)
+{
+	std::vector<DBImplPtr> dbs;
+	{
+		std::lock_guard<std::mutex> lock(m_db_mutex);
+		dbs.reserve(m_dbs.size());
+		for(auto it = m_dbs.begin(); it != m_dbs.end(); ++it)
+		{
+			DBImplPtr db = it->second.lock();
+			if(db)
+			{
+				dbs.push_back(db);
+			}
+		}
+	}
+
+	for(size_t i = 0; i < dbs.size(); ++i)
+	{
+		WritableDB* db = (WritableDB*)dbs[i].get();
+		db->CheckCompaction(bottom_rewrite);
+	}
+}
+
 void WritableEngine::CleanThread(void* arg)
 {
 	LogDebug("clean thread started");	
@@ -416,6 +484,7 @@ void WritableEngine::CleanThread(void* arg)
 	
 	const uint32_t time_ms = engine->m_conf.clean_interval_s * 1000;
 	second_t last_clean_time = time(nullptr);
+	second_t last_compaction_time = last_clean_time;
 
 	std::set<std::string> clean_dbs;    //待清理的db路径
     NotifyMsg nd;
@@ -440,6 +509,15 @@ void WritableEngine::CleanThread(void* arg)
             engine->CleanNotifyFile();
 
             engine->TryDeleteDB();
+
+            bool bottom_rewrite = false;
+            if(engine->m_conf.bottom_rewrite_interval_s != 0 && now_s >= last_compaction_time + engine->m_conf.bottom_rewrite_interval_s)
+            {
+                last_compaction_time = now_s;
+                bottom_rewrite = true;
+            }
+            //FIFO模式的bucket每次都需检测过期的segment
+            engine->CheckCompaction(bottom_rewrite);
         }
 	}
 	
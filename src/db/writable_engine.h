@@ -25,8 +25,10 @@ limitations under the License.
 #include "thread.h"
 #include "queue.h"
 #include "file_notify.h"
+#include "notify_ring.h"
 #include "engine.h"
 #include "db_impl.h"
+#include "merge_scheduler.h"
 
 namespace xfdb 
 {
@@ -38,7 +40,7 @@ public:
 	virtual ~WritableEngine();
 	
 public:
-	virtual Status RemoveDB(const std::string& db_path) override;
+	virtual Status RemoveDB(const std::string& db_path, const DBConfig& dbconf) override;
 
 public:	
 	inline void NotifyWriteDBMeta(DBImplPtr db)
@@ -78,11 +80,23 @@ public:
 		
 		m_full_merge_queue.Push(msg);
 	}
+	inline void NotifyRangeMerge(DBImplPtr db, BucketPtr bucket)
+	{
+		NotifyMsg msg(NOTIFY_RANGE_MERGE, db, bucket);
+		
+		m_full_merge_queue.Push(msg);
+	}
+	inline void NotifyBottomRewrite(DBImplPtr db, BucketPtr bucket)
+	{
+		NotifyMsg msg(NOTIFY_BOTTOM_REWRITE, db, bucket);
+		
+		m_full_merge_queue.Push(msg);
+	}
 	inline void NotifyPartMerge(DBImplPtr db, BucketPtr bucket)
 	{
 		NotifyMsg msg(NOTIFY_PART_MERGE, db, bucket);
 		
-		m_part_merge_queue.Push(msg);
+		m_part_merge_scheduler.Push(msg);
 	}
 	inline void NotifyClean(DBImplPtr db)
 	{
@@ -92,6 +106,8 @@ public:
 
 	void WriteNotifyFile(const NotifyData& nd);
 
+	virtual Status GetMergeQueueStat(MergeQueueStat& stat) override;
+
 protected:
 	virtual Status Start_() override;
 	virtual void Stop_() override;
@@ -108,6 +124,8 @@ private:
 	static void PartMergeThread(size_t index, void* arg);
 	static void FullMergeThread(size_t index, void* arg);
 
+	void CheckCompaction(bool bottom_rewrite);
+
 	void CleanDB(std::set<std::string>& clean_dbs);
 	bool CleanDB(const std::string& db_path);
 	void CleanNotifyFile();
@@ -123,7 +141,7 @@ private:
 	BlockingQueue<NotifyMsg> m_write_segment_queue;
 	ThreadGroup m_write_segment_threadgroup;
 	
-	BlockingQueue<NotifyMsg> m_part_merge_queue;
+	MergeScheduler m_part_merge_scheduler;
 	ThreadGroup m_part_merge_threadgroup;
 	
 	BlockingQueue<NotifyMsg> m_full_merge_queue;
@@ -135,6 +153,7 @@ private:
 	BlockingQueue<NotifyMsg> m_clean_queue;
 	Thread m_clean_thread;
 	std::deque<FileName> m_tobe_delete_notifyfiles;//待删除的通知文件，超过一定时间后被删除
+	NotifyRing m_notify_ring;
 	
 private:	
 	WritableEngine(const WritableEngine&) = delete;
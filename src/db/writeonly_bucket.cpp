@@ -23,6 +23,9 @@ limitations under the License.
 #include "notify_file.h"
 #include "object_reader_snapshot.h"
 #include "writable_db.h"
+#include "rate_limiter.h"
+#include <set>
+#include <cmath>
 
 using namespace xfutil;
 
@@ -38,6 +41,11 @@ WriteOnlyBucket::WriteOnlyBucket(WritableEngine* engine, DBImplPtr db, const Buc
 	m_merged_segment_fileids.reserve(m_merged_reserve_size);
 	m_writed_segment_cnt = 0;
 	m_tobe_clean_bucket_meta_fileid = INVALID_FILE_ID;
+	m_base_meta_retained = false;
+	m_next_path_index = 0;
+	m_rewrite_stat.count = 0;
+	m_rewrite_stat.size = 0;
+	m_bottom_rewrite_pending = false;
 }
 
 WriteOnlyBucket::~WriteOnlyBucket()
@@ -58,6 +66,12 @@ Status WriteOnlyBucket::Create()
 	{
 		return ERR_PATH_CREATE;
 	}
+	DBImplPtr db = m_db.lock();
+	assert(db);
+	if(!CreateSegmentPaths(db->GetPath().c_str(), db->GetConfig().data_paths, m_segment_paths))
+	{
+		return ERR_PATH_CREATE;
+	}
 	
 	//写入空的bucket meta文件
 	BucketMeta bm;
@@ -84,6 +98,16 @@ Status WriteOnlyBucket::Open()
 			return s;
 		}
 	}
+	else
+	{
+		//data_paths可能是新追加的
+		DBImplPtr db = m_db.lock();
+		assert(db);
+		if(!CreateSegmentPaths(db->GetPath().c_str(), db->GetConfig().data_paths, m_segment_paths))
+		{
+			return ERR_PATH_CREATE;
+		}
+	}
 	//获取所有的meta file
 	std::vector<FileName> file_names;
 	Status s = ListBucketMetaFile(m_bucket_path.c_str(), file_names);
@@ -121,7 +145,7 @@ Status WriteOnlyBucket::Open()
 	for(auto it = readers.begin(); it != readers.end(); ++it)
 	{
 		uint8_t level = GetLevelID(MERGE_COUNT(it->first));
-		assert(level <= m_conf.max_level_num);
+		assert(level <= MAX_LEVEL_ID);
 		m_tobe_merge_segments[level][it->first] = it->second->Size();
 	}
 	return OK;
@@ -147,6 +171,7 @@ void WriteOnlyBucket::GetStat(BucketStat& stat) const
 	ObjectWriterPtr memwriter_ptr = m_memwriter;
 	ObjectWriterSnapshotPtr writer_snapshot = m_memwriter_snapshot;
 	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+	stat.rewrite_stat = m_rewrite_stat;
 	m_segment_rwlock.ReadUnlock();
 
 	if(memwriter_ptr)
@@ -228,17 +253,17 @@ Status WriteOnlyBucket::Flush()
 	return Flush(true);
 }
 
-Status WriteOnlyBucket::Remove(const char* bucket_path)
+Status WriteOnlyBucket::Remove(const std::vector<std::string>& segment_paths)
 {
 	std::vector<FileName> file_names;
-	Status s = ListBucketMetaFile(bucket_path, file_names);
+	Status s = ListBucketMetaFile(segment_paths[0].c_str(), file_names);
 	if(s != OK)
 	{		
 		return s;
 	}
 	for(size_t i = 0; i < file_names.size(); ++i)
 	{
-		s = BucketMetaFile::Remove(bucket_path, file_names[i].str);
+		s = BucketMetaFile::Remove(segment_paths, file_names[i].str);
 		if(s != OK)
 		{
 			return s;
@@ -246,15 +271,43 @@ Status WriteOnlyBucket::Remove(const char* bucket_path)
 	}
 
 	//最后删除目录(包括未删除的segment)
-	Directory::Remove(bucket_path);
+	for(const auto& path : segment_paths)
+	{
+		Directory::Remove(path.c_str());
+	}
 	return OK;
 }
 
+uint8_t WriteOnlyBucket::SelectSegmentPath(fileid_t fileid)
+{
+	DBImplPtr db = m_db.lock();
+	assert(db);
+	const std::vector<DataPath>& data_paths = db->GetConfig().data_paths;
+
+	uint8_t level = GetLevelID(MERGE_COUNT(fileid));
+	uint8_t path_ids[0xFF];
+	uint32_t cnt = 0;
+	for(size_t i = 0; i < data_paths.size(); ++i)
+	{
+		if(level >= data_paths[i].min_level && level <= data_paths[i].max_level)
+		{
+			path_ids[cnt++] = i + 1;
+		}
+	}
+	if(cnt == 0)
+	{
+		return 0;
+	}
+	return path_ids[m_next_path_index.fetch_add(1) % cnt];
+}
+
 Status WriteOnlyBucket::RemoveMetaFile()
 {
 	for(;;)
 	{		
 		fileid_t clean_fileid;
+		bool is_base;
+		bool cleaned;
 		{
 			std::lock_guard<std::mutex> guard(m_mutex);
 			if(m_tobe_delete_bucket_meta_fileids.empty()) 
@@ -262,10 +315,24 @@ Status WriteOnlyBucket::RemoveMetaFile()
 				return ERR_NOMORE_DATA;
 			}
 			clean_fileid = m_tobe_delete_bucket_meta_fileids.front();
+			is_base = (clean_fileid == m_base_meta_fileid);
+			cleaned = (m_cleaned_bucket_meta_fileids.find(clean_fileid) != m_cleaned_bucket_meta_fileids.end());
 		}
 		char filename[MAX_FILENAME_LEN];
 		MakeBucketMetaFileName(clean_fileid, filename);
-		Status s = BucketMetaFile::Remove(m_bucket_path.c_str(), filename);
+		//当前全量文件只清理segment，写入新的全量文件后再删除；每个meta的segment文件只清理一次
+		Status s = OK;
+		if(is_base)
+		{
+			if(!cleaned)
+			{
+				s = BucketMetaFile::CleanUnused(m_segment_paths, filename);
+			}
+		}
+		else
+		{
+			s = BucketMetaFile::Remove(m_segment_paths, filename, cleaned);
+		}
 		if(s != OK)
 		{
 			return s;
@@ -276,6 +343,23 @@ Status WriteOnlyBucket::RemoveMetaFile()
 			{
 				m_tobe_delete_bucket_meta_fileids.pop_front();
 			}
+			if(!is_base)
+			{
+				m_cleaned_bucket_meta_fileids.erase(clean_fileid);
+			}
+			else
+			{
+				m_cleaned_bucket_meta_fileids.insert(clean_fileid);
+				if(clean_fileid == m_base_meta_fileid)
+				{
+					m_base_meta_retained = true;
+				}
+				else
+				{
+					//期间已写入新的全量文件
+					m_tobe_delete_bucket_meta_fileids.push_back(clean_fileid);
+				}
+			}
 		}
 	}
 
@@ -301,7 +385,12 @@ Status WriteOnlyBucket::Clean()
 		{
 			char filename[MAX_FILENAME_LEN];
 			MakeBucketMetaFileName(clean_bucket_meta_fileid, filename);
-			s = BucketMetaFile::Clean(m_bucket_path.c_str(), filename);
+			s = BucketMetaFile::Clean(m_segment_paths, filename);
+			if(s == OK)
+			{
+				std::lock_guard<std::mutex> guard(m_mutex);
+				m_cleaned_bucket_meta_fileids.insert(clean_bucket_meta_fileid);
+			}
 		} 
 	}
 	return s;
@@ -313,13 +402,15 @@ Status WriteOnlyBucket::WriteSegment(ObjectWriterSnapshotPtr& memwriter_snapshot
 	
 	SegmentStat seg_stat;
 	seg_stat.segment_fileid = fileid;
+	seg_stat.path_id = SelectSegmentPath(fileid);
+	const char* segment_path = SegmentPath(seg_stat.path_id);
 
 	DBImplPtr db = m_db.lock();
 	assert(db);
 	{
 		auto& bucket_conf = db->GetConfig().GetBucketConfig(m_info.name);
 		SegmentWriter segment_writer(bucket_conf, m_engine->GetLargeBlockPool());
-		Status s = segment_writer.Create(m_bucket_path.c_str(), fileid);
+		Status s = segment_writer.Create(segment_path, fileid, memwriter_snapshot->Size());
 		if(s != OK)
 		{
 			return s;
@@ -331,7 +422,7 @@ Status WriteOnlyBucket::WriteSegment(ObjectWriterSnapshotPtr& memwriter_snapshot
 		}
 	}
 	new_segment_reader = NewSegmentReader();
-	return new_segment_reader->Open(m_bucket_path.c_str(), seg_stat);
+	return new_segment_reader->Open(segment_path, seg_stat);
 }
 
 //多线程同时执行
@@ -344,7 +435,7 @@ Status WriteOnlyBucket::WriteSegment()
         ObjectReaderSnapshotPtr reader_snapshot;
 
 		std::lock_guard<std::mutex> lock(m_mutex);
-		if(m_next_segment_id >= MAX_SEGMENT_ID)
+		if(m_next_segment_id > MAX_SEGMENT_ID - SEGMENT_SLOT_SIZE)
 		{
 			return ERR_RES_EXHAUST;
 		}
@@ -355,7 +446,10 @@ Status WriteOnlyBucket::WriteSegment()
 		}
 		memwriter_snapshot.swap(m_memwriter_snapshot);
 
-		fileid_t new_segment_id = m_next_segment_id++;
+		//按槽分配，旧版本的segment id之后从SLOT_SEGMENT_ID_BASE开始
+		fileid_t new_segment_id = MAX(m_next_segment_id, SLOT_SEGMENT_ID_BASE);
+		new_segment_id = (new_segment_id + SEGMENT_SLOT_SIZE - 1) & ~(SEGMENT_SLOT_SIZE - 1);
+		m_next_segment_id = new_segment_id + SEGMENT_SLOT_SIZE;
 		fileid = SEGMENT_FILEID(new_segment_id, 0);
 		m_writing_segments[fileid] = 0;
 
@@ -413,6 +507,10 @@ Status WriteOnlyBucket::WriteSegment()
 		DBImplPtr db = m_db.lock();
 		assert(db);
 		
+		if(m_conf.compaction_style == COMPACTION_FIFO)
+		{
+			FIFODrop();
+		}
 		m_engine->NotifyWriteBucketMeta(db, shared_from_this());
 		//FIXME:判断是否需要merge
 		m_engine->NotifyPartMerge(db, shared_from_this());
@@ -429,9 +527,24 @@ Status WriteOnlyBucket::Merge()
 	return OK;
 }
 
+Status WriteOnlyBucket::Merge(const StrView& start_key, const StrView& end_key)
+{
+	if(m_conf.compaction_style == COMPACTION_FIFO)
+	{
+		return OK;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tobe_merge_ranges.push_back(std::make_pair(std::string(start_key.data, start_key.size), std::string(end_key.data, end_key.size)));
+	}
+	DBImplPtr db = m_db.lock();
+	m_engine->NotifyRangeMerge(db, shared_from_this());
+	return OK;
+}
+
 Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 {		
-	if(msinfo.merging_segment_fileids.size() <= 1)
+	if(msinfo.merging_segment_fileids.empty())
 	{
 		return OK;
 	}
@@ -441,6 +554,8 @@ Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 
 	SegmentStat seg_stat;
 	seg_stat.segment_fileid = msinfo.new_segment_fileid;
+	seg_stat.path_id = SelectSegmentPath(msinfo.new_segment_fileid);
+	const char* segment_path = SegmentPath(seg_stat.path_id);
 	{
 		BucketConfig tmp_bucket_conf = m_conf;
 		//超过一定大小的段不用布隆
@@ -450,7 +565,8 @@ Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 		}
 
 		SegmentWriter segment_writer(tmp_bucket_conf, m_engine->GetLargeBlockPool());
-		Status s = segment_writer.Create(m_bucket_path.c_str(), msinfo.new_segment_fileid);
+		Status s = segment_writer.Create(segment_path, msinfo.new_segment_fileid, msinfo.GetMergingSize(), 
+								m_engine->GetConfig().merge_bypass_cache);
 		if(s != OK)
 		{
             LogWarn("open create segment(id=%ld) of bucket(%s) failed, status: %u", msinfo.new_segment_fileid, m_bucket_path.c_str(), s);
@@ -466,7 +582,7 @@ Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 	}
 
 	msinfo.new_segment_reader = NewSegmentReader();
-	Status s = msinfo.new_segment_reader->Open(m_bucket_path.c_str(), seg_stat);
+	Status s = msinfo.new_segment_reader->Open(segment_path, seg_stat);
 	if(s != OK)
 	{
         LogWarn("open new segment(id=%ld) of bucket(%s) failed, status: %u", seg_stat.segment_fileid, m_bucket_path.c_str(), s);
@@ -481,7 +597,7 @@ Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 			m_merged_segment_fileids.push_back(*it);
 		}
 		uint8_t level = GetLevelID(MERGE_COUNT(msinfo.new_segment_fileid));
-		assert(level <= m_conf.max_level_num);
+		assert(level <= MAX_LEVEL_ID);
 
 		m_merging_segment_fileids[level][msinfo.new_segment_fileid] = msinfo.new_segment_reader->Size();
 		for(auto it = m_merging_segment_fileids[level].begin(); it != m_merging_segment_fileids[level].end();)
@@ -514,15 +630,20 @@ Status WriteOnlyBucket::Merge(MergingSegmentInfo& msinfo)
 	}
 	
 	m_engine->NotifyWriteBucketMeta(db, shared_from_this());
-	//FIXME:判断是否需要merge
+	//由调度器根据合并分数判断是否需要继续merge
 	m_engine->NotifyPartMerge(db, shared_from_this());
 
 	return OK;
 }
 
-bool WriteOnlyBucket::AddMerging(MergingSegmentInfo& msinfo)
+bool WriteOnlyBucket::AddMerging(MergingSegmentInfo& msinfo, bool rewrite)
 {
-	if(msinfo.merging_segment_fileids.size() <= 1)
+	if(msinfo.merging_segment_fileids.size() <= (rewrite ? 0 : 1))
+	{
+		return false;
+	}
+	msinfo.new_segment_fileid = msinfo.NewSegmentFileID();
+	if(msinfo.new_segment_fileid == INVALID_FILE_ID)
 	{
 		return false;
 	}
@@ -530,11 +651,9 @@ bool WriteOnlyBucket::AddMerging(MergingSegmentInfo& msinfo)
 	m_segment_rwlock.ReadLock();
 	msinfo.reader_snapshot = m_reader_snapshot;
 	m_segment_rwlock.ReadUnlock();
-
-	msinfo.new_segment_fileid = msinfo.NewSegmentFileID();
 	
 	uint8_t new_level = GetLevelID(MERGE_COUNT(msinfo.new_segment_fileid));
-	assert(new_level <= m_conf.max_level_num);
+	assert(new_level <= MAX_LEVEL_ID);
 	assert(m_merging_segment_fileids[new_level].find(msinfo.new_segment_fileid) == m_merging_segment_fileids[new_level].end());
 	m_merging_segment_fileids[new_level][msinfo.new_segment_fileid] = 0;
 
@@ -549,6 +668,11 @@ bool WriteOnlyBucket::AddMerging(MergingSegmentInfo& msinfo)
 //单线程执行
 Status WriteOnlyBucket::FullMerge()
 {
+	if(m_conf.compaction_style == COMPACTION_FIFO)
+	{
+		return OK;
+	}
+
 	std::vector<MergingSegmentInfo> msinfos;
 	{		
 		std::lock_guard<std::mutex> lock(m_mutex);
@@ -603,44 +727,599 @@ Status WriteOnlyBucket::FullMerge()
 	return OK;
 }
 
-//多线程执行
-Status WriteOnlyBucket::PartMerge()
-{	
-	const uint32_t merge_factor = m_engine->GetConfig().merge_factor;
+//计算某一层的合并分数，取segment数量、层大小与目标大小之比的较大值，再加上删除比例
+//注：需在m_mutex锁内调用
+double WriteOnlyBucket::GetLevelMergeScore(uint8_t level, const std::map<fileid_t, ObjectReaderPtr>& readers, uint32_t* eligible_count)
+{
+	const GlobalConfig& gconf = m_engine->GetConfig();
+	const uint32_t merge_factor = gconf.merge_factor;
+
+	uint32_t count = 0;
+	uint64_t level_size = 0;
+	BucketStat stat = {0};
+	for(auto it = m_tobe_merge_segments[level].begin(); it != m_tobe_merge_segments[level].end(); ++it)
+	{
+		//如果segment大小超过阈值，则不参与合并
+		if(it->second >= gconf.max_merge_size)
+		{
+			continue;
+		}
+		++count;
+		level_size += it->second;
+
+		auto rit = readers.find(it->first);
+		if(rit != readers.end())
+		{
+			rit->second->GetBucketStat(stat);
+		}
+	}
+	if(eligible_count != nullptr)
+	{
+		*eligible_count = count;
+	}
+	if(count <= 1)
+	{
+		return 0;
+	}
+
+	//第level层的目标大小：max_memtable_size * merge_factor^(level+1)
+	double target_size = (double)gconf.max_memtable_size * merge_factor;
+	for(uint8_t i = 0; i < level; ++i)
+	{
+		target_size *= merge_factor;
+	}
+
+	double score = MAX((double)count / merge_factor, level_size / target_size);
+	//删除占比高的层提前合并，force_merge_deleted_percent为0时关闭
+	uint64_t object_count = stat.object_stat.Count();
+	if(gconf.force_merge_deleted_percent != 0 && object_count != 0)
+	{
+		score += (double)stat.object_stat.delete_stat.count / object_count;
+	}
+	return score;
+}
+
+//删除标记只有合并到最底层时才能消除，因此删除占比高的segment需要与所有更老的segment一起合并
+//从最老的segment开始，按每个segment自身的删除占比查找第一个超过阈值的segment；最老的segment超过阈值时单独重写（不受大小限制）
+//更老的segment总大小达到max_merge_size后停止查找，避免为少量删除重写大量老数据
+//注：需在m_mutex锁内调用
+double WriteOnlyBucket::GetDeleteMergeScore(const std::map<fileid_t, ObjectReaderPtr>& readers, std::set<fileid_t>* merging_fileids)
+{
+	const GlobalConfig& gconf = m_engine->GetConfig();
+	if(gconf.force_merge_deleted_percent == 0)
+	{
+		return 0;
+	}
 
-	//每层都尝试合并一下
-	for(uint8_t level = 0; level <= m_conf.max_level_num; ++level)
+	uint64_t older_size = 0;
+	for(auto it = readers.begin(); it != readers.end(); ++it)
 	{
-		for(;;)
+		fileid_t fileid = it->first;
+		uint8_t level = GetLevelID(MERGE_COUNT(fileid));
+
+		//有segment正在合并或不可合并时，更新的segment都无法合并到最底层
+		auto seg_it = m_tobe_merge_segments[level].find(fileid);
+		if(seg_it == m_tobe_merge_segments[level].end())
+		{
+			break;
+		}
+		//最老的segment merge次数已达最大值时只能单独重写
+		if(it == readers.begin() ? (RewriteSegmentFileID(fileid) == INVALID_FILE_ID) : (MERGE_COUNT(readers.begin()->first) >= MAX_MERGE_COUNT))
 		{
-			MergingSegmentInfo msinfo;
+			break;
+		}
+
+		BucketStat stat = {0};
+		it->second->GetBucketStat(stat);
+		uint64_t deleted_count = stat.object_stat.delete_stat.count;
+		if(deleted_count >= MIN_FORCE_MERGE_DELETED_NUM)
+		{
+			double score = (double)deleted_count * 100 / ((double)stat.object_stat.Count() * gconf.force_merge_deleted_percent);
+			if(score >= 1.0)
 			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				if(m_tobe_merge_segments[level].size() < merge_factor)
+				if(merging_fileids != nullptr)
 				{
-					break;
+					for(auto mit = readers.begin(); mit != std::next(it); ++mit)
+					{
+						merging_fileids->insert(mit->first);
+					}
 				}
+				return score;
+			}
+		}
+
+		older_size += seg_it->second;
+		if(older_size >= gconf.max_merge_size)
+		{
+			break;
+		}
+	}
+	return 0;
+}
+
+double WriteOnlyBucket::GetMergeScore()
+{
+	if(m_conf.compaction_style == COMPACTION_FIFO)
+	{
+		return 0;
+	}
+
+	m_segment_rwlock.ReadLock();
+	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+	m_segment_rwlock.ReadUnlock();
+
+	double score = 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	//level已达最大值的segment不参与合并
+	for(uint8_t level = 0; level < m_conf.max_level_num; ++level)
+	{
+		double level_score = GetLevelMergeScore(level, reader_snapshot->Readers());
+		score = MAX(score, level_score);
+	}
+	double delete_score = GetDeleteMergeScore(reader_snapshot->Readers());
+	return MAX(score, delete_score);
+}
+
+//多线程执行，每次只合并分数最高的一组segment，合并完成后会重新通知调度
+Status WriteOnlyBucket::PartMerge()
+{	
+	if(m_conf.compaction_style == COMPACTION_FIFO)
+	{
+		return ERR_NOMORE_DATA;
+	}
+	const GlobalConfig& gconf = m_engine->GetConfig();
+
+	MergingSegmentInfo msinfo;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
 
-				auto it = m_tobe_merge_segments[level].begin();
-				for(uint32_t m = 0; m < merge_factor; ++m, ++it)
+		//在锁内获取，保证与m_tobe_merge_segments一致
+		m_segment_rwlock.ReadLock();
+		ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+		m_segment_rwlock.ReadUnlock();
+
+		uint8_t merge_level = MAX_LEVEL_ID + 1;
+		double max_score = 0;
+		for(uint8_t level = 0; level < m_conf.max_level_num; ++level)
+		{
+			double score = GetLevelMergeScore(level, reader_snapshot->Readers());
+			if(score >= 1.0 && score > max_score)
+			{
+				max_score = score;
+				merge_level = level;
+			}
+		}
+
+		bool rewrite = false;
+		std::set<fileid_t> delete_merge_fileids;
+		double delete_score = GetDeleteMergeScore(reader_snapshot->Readers(), &delete_merge_fileids);
+		if(delete_score >= 1.0 && delete_score > max_score)
+		{
+			//只有最老的segment时单独重写
+			msinfo.merging_segment_fileids.swap(delete_merge_fileids);
+			rewrite = (msinfo.merging_segment_fileids.size() == 1);
+		}
+		else if(merge_level <= MAX_LEVEL_ID)
+		{
+			//按fileid顺序选取第一组连续的可合并segment（中间不能夹杂其他segment），最多merge_factor个，保证合并后新旧顺序不变
+			const auto& readers = reader_snapshot->Readers();
+			for(auto it = readers.begin(); it != readers.end(); ++it)
+			{
+				auto seg_it = m_tobe_merge_segments[merge_level].find(it->first);
+				if(seg_it != m_tobe_merge_segments[merge_level].end() && seg_it->second < gconf.max_merge_size)
 				{
-					//如果segment大小超过阈值或level已达最大值，则不参与合并
-					if(it->second >= m_engine->GetConfig().max_merge_size || GetLevelID(MERGE_COUNT(it->first)) >= m_conf.max_level_num)
+					msinfo.merging_segment_fileids.insert(it->first);
+					if(msinfo.merging_segment_fileids.size() >= gconf.merge_factor)
 					{
 						break;
 					}
-					msinfo.merging_segment_fileids.insert(it->first);
 				}
-				AddMerging(msinfo);
+				else if(msinfo.merging_segment_fileids.size() > 1)
+				{
+					break;
+				}
+				else
+				{
+					msinfo.merging_segment_fileids.clear();
+				}
+			}
+		}
+		if(!AddMerging(msinfo, rewrite))
+		{
+			return ERR_NOMORE_DATA;
+		}
+	}
+
+	return Merge(msinfo);
+}
+
+//按fileid从老到新选取key范围与[start_key, end_key)有重叠的segment，不受max_merge_size限制
+//中间跳过的segment必须与之后选取的segment的key范围没有重叠，否则合并后新旧顺序会改变，此时停止选取
+//返回false表示有重叠的segment正在合并
+//注：需在m_mutex锁内调用
+bool WriteOnlyBucket::PickRangeMerge(const std::map<fileid_t, ObjectReaderPtr>& readers, const std::string& start_key, const std::string& end_key, std::set<fileid_t>& merging_fileids)
+{
+	const StrView start(start_key.data(), start_key.size());
+	const StrView end(end_key.data(), end_key.size());
+
+	std::vector<SegmentReaderPtr> skipped_readers;
+	for(auto it = readers.begin(); it != readers.end(); ++it)
+	{
+		//正在写的segment，比其他segment都新
+		SegmentReaderPtr segment_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+		if(!segment_reader)
+		{
+			break;
+		}
+		const StrView min_key = segment_reader->MinKey();
+		const StrView& max_key = segment_reader->MaxKey();
+
+		if(max_key.Compare(start) < 0 || (end.size != 0 && min_key.Compare(end) >= 0))
+		{
+			if(!merging_fileids.empty())
+			{
+				skipped_readers.push_back(segment_reader);
+			}
+			continue;
+		}
+
+		uint8_t level = GetLevelID(MERGE_COUNT(it->first));
+		if(m_tobe_merge_segments[level].find(it->first) == m_tobe_merge_segments[level].end())
+		{
+			if(merging_fileids.empty())
+			{
+				return false;
+			}
+			break;
+		}
+
+		bool overlapped = false;
+		for(size_t i = 0; i < skipped_readers.size(); ++i)
+		{
+			if(skipped_readers[i]->MaxKey().Compare(min_key) >= 0 && skipped_readers[i]->MinKey().Compare(max_key) <= 0)
+			{
+				overlapped = true;
+				break;
+			}
+		}
+		if(overlapped)
+		{
+			break;
+		}
+		merging_fileids.insert(it->first);
+	}
+
+	//最老的segment merge次数已达最大值时无法作为合并后的fileid，跳过它不影响新旧顺序
+	if(merging_fileids.size() > 1 && MERGE_COUNT(*merging_fileids.begin()) >= MAX_MERGE_COUNT)
+	{
+		merging_fileids.erase(merging_fileids.begin());
+	}
+	return true;
+}
+
+//单线程执行，每次处理一个范围，与范围有重叠的segment合并为一个segment，只有一个时则重写
+Status WriteOnlyBucket::RangeMerge()
+{
+	MergingSegmentInfo msinfo;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_tobe_merge_ranges.empty())
+		{
+			return ERR_NOMORE_DATA;
+		}
+
+		m_segment_rwlock.ReadLock();
+		ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+		m_segment_rwlock.ReadUnlock();
+
+		const auto& range = m_tobe_merge_ranges.front();
+		if(!PickRangeMerge(reader_snapshot->Readers(), range.first, range.second, msinfo.merging_segment_fileids))
+		{
+			return ERR_IN_PROCESSING;
+		}
+		m_tobe_merge_ranges.pop_front();
+
+		if(!AddMerging(msinfo, msinfo.merging_segment_fileids.size() == 1))
+		{
+			return ERR_NOMORE_DATA;
+		}
+	}
+
+	return Merge(msinfo);
+}
+
+//不参与merge的segment（超过max_merge_size）中，有未检查过且key范围重叠的更新segment时才可能需要重写
+//注：需在m_mutex锁内调用
+void WriteOnlyBucket::GetBottomRewriteCandidates(const std::map<fileid_t, ObjectReaderPtr>& readers, std::vector<fileid_t>& fileids)
+{
+	const GlobalConfig& gconf = m_engine->GetConfig();
+
+	for(auto it = readers.begin(); it != readers.end(); ++it)
+	{
+		uint8_t level = GetLevelID(MERGE_COUNT(it->first));
+		auto seg_it = m_tobe_merge_segments[level].find(it->first);
+		if(seg_it == m_tobe_merge_segments[level].end())
+		{
+			continue;
+		}
+		//只有旧版本的segment id在merge次数达到最大值后无法重写
+		if(seg_it->second < gconf.max_merge_size || RewriteSegmentFileID(it->first) == INVALID_FILE_ID)
+		{
+			continue;
+		}
+		SegmentReaderPtr segment_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+		if(!segment_reader)
+		{
+			continue;
+		}
+		const StrView min_key = segment_reader->MinKey();
+		const StrView& max_key = segment_reader->MaxKey();
+
+		for(auto nit = std::next(it); nit != readers.end(); ++nit)
+		{
+			SegmentReaderPtr newer_reader = std::dynamic_pointer_cast<SegmentReader>(nit->second);
+			if(!newer_reader || newer_reader->MaxMergeSegmentID() <= segment_reader->MaxMergeSegmentID())
+			{
+				continue;
+			}
+			if(newer_reader->MaxKey().Compare(min_key) >= 0 && newer_reader->MinKey().Compare(max_key) <= 0)
+			{
+				fileids.push_back(it->first);
+				break;
 			}
+		}
+	}
+}
 
-			Status s = Merge(msinfo);
-			if(s != OK)
+//从segment中均匀抽取key，按被更新的segment覆盖（set或delete）的比例估算垃圾占比，与重写时ShadowFilterIterator的判断一致
+//只检查key范围有重叠且未检查过的segment，同一key在多个更新的segment中只计一次，不存在于该segment中的新key不计入
+double WriteOnlyBucket::GetBottomGarbageRatio(const std::map<fileid_t, ObjectReaderPtr>& readers, fileid_t fileid)
+{
+	auto it = readers.find(fileid);
+	if(it == readers.end())
+	{
+		return 0;
+	}
+	SegmentReaderPtr segment_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+	if(!segment_reader)
+	{
+		return 0;
+	}
+	const StrView min_key = segment_reader->MinKey();
+	const StrView& max_key = segment_reader->MaxKey();
+
+	//由新到老存放
+	std::vector<SegmentReaderPtr> newer_readers;
+	for(auto rit = readers.rbegin(); rit != readers.rend() && rit->first > fileid; ++rit)
+	{
+		SegmentReaderPtr newer_reader = std::dynamic_pointer_cast<SegmentReader>(rit->second);
+		if(!newer_reader || newer_reader->MaxMergeSegmentID() <= segment_reader->MaxMergeSegmentID())
+		{
+			continue;
+		}
+		if(newer_reader->MaxKey().Compare(min_key) < 0 || newer_reader->MinKey().Compare(max_key) > 0)
+		{
+			continue;
+		}
+		newer_readers.push_back(newer_reader);
+	}
+	if(newer_readers.empty())
+	{
+		return 0;
+	}
+
+	std::vector<std::string> keys;
+	segment_reader->SampleKeys(BOTTOM_REWRITE_SAMPLE_NUM, keys);
+	if(keys.empty())
+	{
+		return 0;
+	}
+
+	//按key逐个点查更新的segment（先经key范围和bloom filter过滤），只统计确实被覆盖或删除的key，避免重复计数
+	size_t shadowed_count = 0;
+	ObjectType type;
+	std::string value;
+	for(size_t i = 0; i < keys.size(); ++i)
+	{
+		StrView key(keys[i]);
+		for(size_t j = 0; j < newer_readers.size(); ++j)
+		{
+			if(newer_readers[j]->Get(key, MAX_OBJECT_ID, type, value) != OK)
+			{
+				continue;
+			}
+			//append需与更老的值合并，继续查找
+			if(type != AppendType)
 			{
-				return s;
+				++shadowed_count;
+				break;
 			}
 		}
 	}
+	return (double)shadowed_count / keys.size();
+}
+
+//选取估算的垃圾占比最高的不参与merge的segment
+//注：抽样需要读文件，不能在m_mutex锁内调用
+bool WriteOnlyBucket::PickBottomRewrite(const std::map<fileid_t, ObjectReaderPtr>& readers, fileid_t& fileid)
+{
+	std::vector<fileid_t> candidates;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		GetBottomRewriteCandidates(readers, candidates);
+	}
+
+	const GlobalConfig& gconf = m_engine->GetConfig();
+	double max_ratio = 0;
+	for(size_t i = 0; i < candidates.size(); ++i)
+	{
+		double ratio = GetBottomGarbageRatio(readers, candidates[i]);
+		if(ratio * 100 >= gconf.bottom_rewrite_garbage_percent && ratio > max_ratio)
+		{
+			max_ratio = ratio;
+			fileid = candidates[i];
+		}
+	}
+	return (max_ratio > 0);
+}
+
+//单线程执行，每次只重写一个segment，io以最低优先级限速
+Status WriteOnlyBucket::BottomRewrite()
+{
+	IOPriorityGuard io_guard(IO_PRIORITY_LOW);
+
+	m_segment_rwlock.ReadLock();
+	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+	m_segment_rwlock.ReadUnlock();
+
+	fileid_t fileid;
+	bool picked = PickBottomRewrite(reader_snapshot->Readers(), fileid);
+	m_bottom_rewrite_pending = false;
+	if(!picked)
+	{
+		return ERR_NOMORE_DATA;
+	}
+
+	MergingSegmentInfo msinfo;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		//抽样期间segment可能已开始合并
+		uint8_t level = GetLevelID(MERGE_COUNT(fileid));
+		if(m_tobe_merge_segments[level].find(fileid) == m_tobe_merge_segments[level].end())
+		{
+			return ERR_IN_PROCESSING;
+		}
+		msinfo.merging_segment_fileids.insert(fileid);
+		if(!AddMerging(msinfo, true))
+		{
+			return ERR_IN_PROCESSING;
+		}
+	}
+
+	uint64_t size = msinfo.GetMergingSize();
+	Status s = Merge(msinfo);
+	if(s == OK)
+	{
+		WriteLockGuard lock_guard(m_segment_rwlock);
+		m_rewrite_stat.Add(size);
+	}
+	return s;
+}
+
+Status WriteOnlyBucket::CheckCompaction(bool bottom_rewrite)
+{
+	if(m_conf.compaction_style == COMPACTION_FIFO)
+	{
+		Status s = FIFODrop();
+		if(s == OK)
+		{
+			DBImplPtr db = m_db.lock();
+			m_engine->NotifyWriteBucketMeta(db, shared_from_this());
+		}
+		return s;
+	}
+	if(!bottom_rewrite)
+	{
+		return ERR_NOMORE_DATA;
+	}
+
+	m_segment_rwlock.ReadLock();
+	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+	m_segment_rwlock.ReadUnlock();
+
+	//只检查是否有候选segment，抽样估算在merge线程中进行
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::vector<fileid_t> candidates;
+		GetBottomRewriteCandidates(reader_snapshot->Readers(), candidates);
+		if(candidates.empty())
+		{
+			return ERR_NOMORE_DATA;
+		}
+	}
+
+	//上次通知的抽样尚未完成时不再通知
+	if(m_bottom_rewrite_pending.exchange(true))
+	{
+		return ERR_IN_PROCESSING;
+	}
+	DBImplPtr db = m_db.lock();
+	m_engine->NotifyBottomRewrite(db, shared_from_this());
+	return OK;
+}
+
+//按fileid从老到新删除超过大小或时间限制的segment，至少保留最新的一个
+//只将其加入m_merged_segment_fileids，由写bucket meta和clean流程删除文件，不产生额外io
+//segment的创建时间取index文件的修改时间
+Status WriteOnlyBucket::FIFODrop()
+{
+	const second_t now_s = time(nullptr);
+	std::vector<fileid_t> drop_fileids;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_segment_rwlock.ReadLock();
+	ObjectReaderSnapshotPtr reader_snapshot = m_reader_snapshot;
+	m_segment_rwlock.ReadUnlock();
+
+	uint64_t total_size = 0;
+	size_t segment_cnt = 0;
+	for(uint8_t level = 0; level <= MAX_LEVEL_ID; ++level)
+	{
+		for(auto it = m_tobe_merge_segments[level].begin(); it != m_tobe_merge_segments[level].end(); ++it)
+		{
+			total_size += it->second;
+		}
+		segment_cnt += m_tobe_merge_segments[level].size();
+	}
+
+	const auto& readers = reader_snapshot->Readers();
+	for(auto it = readers.begin(); it != readers.end() && drop_fileids.size() + 1 < segment_cnt; ++it)
+	{
+		//遇到正在写的segment则停止，保证只删除最老的segment
+		uint8_t level = GetLevelID(MERGE_COUNT(it->first));
+		auto seg_it = m_tobe_merge_segments[level].find(it->first);
+		if(seg_it == m_tobe_merge_segments[level].end())
+		{
+			break;
+		}
+
+		bool expired = (m_conf.fifo_max_size != 0 && total_size > m_conf.fifo_max_size);
+		if(!expired && m_conf.fifo_ttl_s != 0)
+		{
+			SegmentReaderPtr seg_reader = std::dynamic_pointer_cast<SegmentReader>(it->second);
+			char index_path[MAX_PATH_LEN];
+			MakeIndexFilePath(SegmentPath(seg_reader ? seg_reader->Stat().path_id : 0), it->first, index_path);
+			second_t create_time = File::ModifyTime(index_path);
+			expired = (create_time != 0 && now_s >= create_time + m_conf.fifo_ttl_s);
+		}
+		if(!expired)
+		{
+			break;
+		}
+
+		total_size -= seg_it->second;
+		m_tobe_merge_segments[level].erase(seg_it);
+		m_merged_segment_fileids.push_back(it->first);
+		drop_fileids.push_back(it->first);
+	}
+	if(drop_fileids.empty())
+	{
+		return ERR_NOMORE_DATA;
+	}
+
+	WriteLockGuard lock_guard(m_segment_rwlock);
+	std::map<fileid_t, ObjectReaderPtr> new_readers = m_reader_snapshot->Readers();
+	for(size_t i = 0; i < drop_fileids.size(); ++i)
+	{
+		new_readers.erase(drop_fileids[i]);
+	}
+	ObjectReaderSnapshotPtr new_reader_snapshot = NewObjectReaderSnapshot(m_reader_snapshot->MetaFile(), new_readers);
+	m_reader_snapshot.swap(new_reader_snapshot);
+
+	LogInfo("drop %zu oldest segments of fifo bucket(%s)", drop_fileids.size(), m_bucket_path.c_str());
 	return OK;
 }
 
@@ -661,6 +1340,56 @@ void WriteOnlyBucket::GetAliveSegmentStat(ObjectReaderSnapshotPtr& ors_ptr, Buck
 	}
 }
 
+void WriteOnlyBucket::MakeBucketMetaEdit(BucketMeta& bm)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_base_meta_fileid != INVALID_FILE_ID)
+	{
+		std::set<fileid_t> base_fileids;
+		for(const auto& stat : m_base_segment_stats)
+		{
+			base_fileids.insert(stat.segment_fileid);
+		}
+		std::vector<SegmentStat> added_stats;
+		for(const auto& stat : bm.alive_segment_stats)
+		{
+			if(base_fileids.erase(stat.segment_fileid) == 0)
+			{
+				added_stats.push_back(stat);
+			}
+		}
+		//剩下的是全量文件之后删除的segment
+		size_t edit_cnt = added_stats.size() + base_fileids.size();
+
+		//增量超过全量的平方根量级时写全量，使每次平均写入的量远小于全量
+		size_t max_edit_cnt = 16 + 2 * (size_t)sqrt((double)m_base_segment_stats.size());
+		if(edit_cnt <= max_edit_cnt)
+		{
+			bm.base_fileid = m_base_meta_fileid;
+			bm.alive_segment_stats.swap(added_stats);
+			bm.removed_segment_fileids.assign(base_fileids.begin(), base_fileids.end());
+			return;
+		}
+	}
+}
+
+void WriteOnlyBucket::SwitchBaseMeta(fileid_t bucket_meta_fileid, const BucketMeta& bm)
+{
+	//NOTE:调用方需持有m_mutex
+	if(bm.base_fileid != INVALID_FILE_ID)
+	{
+		return;
+	}
+	//旧的全量文件排在依赖它的增量文件之后删除
+	if(m_base_meta_retained)
+	{
+		m_tobe_delete_bucket_meta_fileids.push_back(m_base_meta_fileid);
+		m_base_meta_retained = false;
+	}
+	m_base_meta_fileid = bucket_meta_fileid;
+	m_base_segment_stats = bm.alive_segment_stats;
+}
+
 //保证只被1个线程调用
 Status WriteOnlyBucket::WriteBucketMeta()
 {
@@ -698,6 +1427,7 @@ Status WriteOnlyBucket::WriteBucketMeta()
 	}
 	
 	GetAliveSegmentStat(reader_snapshot, bm);
+	MakeBucketMetaEdit(bm);
 	Status s = BucketMetaFile::Write(m_bucket_path.c_str(), bucket_meta_fileid, bm);
 	if(s != OK)
 	{
@@ -719,14 +1449,18 @@ Status WriteOnlyBucket::WriteBucketMeta()
 	DBImplPtr db = m_db.lock();
 	assert(db);
 
-	//加入清理队列
-	if(bucket_meta_file)
+	//写入成功后才切换全量文件，加入清理队列
 	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		SwitchBaseMeta(bucket_meta_fileid, bm);
+		if(bucket_meta_file)
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
 			m_tobe_clean_bucket_meta_fileid = bucket_meta_fileid;
 			m_tobe_delete_bucket_meta_fileids.push_back(bucket_meta_file->FileID());
 		}
+	}
+	if(bucket_meta_file)
+	{
 		m_engine->NotifyClean(db);
 	}	
 
@@ -48,10 +48,16 @@ public:
 	virtual Status TryFlush() override;
 	virtual Status Flush() override;
 	virtual Status Merge() override;
+	virtual Status Merge(const StrView& start_key, const StrView& end_key) override;
 
 	virtual	Status Clean() override;
+	virtual Status CheckCompaction(bool bottom_rewrite) override;
 
-	static Status Remove(const char* bucket_path);
+	//segment_paths见MakeSegmentPaths
+	static Status Remove(const std::vector<std::string>& segment_paths);
+
+	//part merge的合并分数，>=1时表示需要合并
+	double GetMergeScore();
 
 protected:	
 	virtual ObjectWriterPtr NewObjectWriter(WritableEngine* engine);
@@ -64,6 +70,8 @@ protected:
 private:
 	Status Create();
 	Status RemoveMetaFile();
+	//新segment的存放目录：覆盖其level的data_paths轮流存放，没有时为bucket目录
+	uint8_t SelectSegmentPath(fileid_t fileid);
 
 	Status WriteSegment();			//同步刷盘
 	Status WriteSegment(ObjectWriterSnapshotPtr& memwriter_snapshot, fileid_t fileid, SegmentReaderPtr& new_segment_reader);
@@ -73,10 +81,25 @@ private:
 	Status Merge(MergingSegmentInfo& msinfo);
 	Status FullMerge();				//同步merge
 	Status PartMerge();				//同步merge，写入时合并降低速度？
-	bool AddMerging(MergingSegmentInfo& msinfo);
+	bool AddMerging(MergingSegmentInfo& msinfo, bool rewrite = false);
+
+	Status RangeMerge();			//同步merge与指定范围有重叠的segment
+	bool PickRangeMerge(const std::map<fileid_t, ObjectReaderPtr>& readers, const std::string& start_key, const std::string& end_key, std::set<fileid_t>& merging_fileids);
+
+	Status BottomRewrite();			//同步重写不参与merge的segment
+	Status FIFODrop();				//FIFO模式删除最老的segment，只修改bucket meta
+	bool PickBottomRewrite(const std::map<fileid_t, ObjectReaderPtr>& readers, fileid_t& fileid);
+	void GetBottomRewriteCandidates(const std::map<fileid_t, ObjectReaderPtr>& readers, std::vector<fileid_t>& fileids);
+	double GetBottomGarbageRatio(const std::map<fileid_t, ObjectReaderPtr>& readers, fileid_t fileid);
+	double GetLevelMergeScore(uint8_t level, const std::map<fileid_t, ObjectReaderPtr>& readers, uint32_t* eligible_count = nullptr);
+	double GetDeleteMergeScore(const std::map<fileid_t, ObjectReaderPtr>& readers, std::set<fileid_t>* merging_fileids = nullptr);
 	
 private:
 	void GetAliveSegmentStat(ObjectReaderSnapshotPtr& ors_ptr, BucketMeta& bm);
+	//变化较少时将bm改为相对于当前全量文件的增量，否则bm作为新的全量文件
+	void MakeBucketMetaEdit(BucketMeta& bm);
+	//bm写入成功后，若为全量文件则替换当前全量文件
+	void SwitchBaseMeta(fileid_t bucket_meta_fileid, const BucketMeta& bm);
 
 protected:
 	WritableEngine* m_engine;
@@ -96,9 +119,16 @@ protected:
 	std::map<fileid_t, uint64_t> m_tobe_merge_segments[MAX_LEVEL_ID+1];	    //所有level层的segment，用于merge
 	std::map<fileid_t, uint64_t> m_merging_segment_fileids[MAX_LEVEL_ID+1];	//正在合并的segment
 	std::vector<fileid_t> m_merged_segment_fileids;						    //已合并并待删除的segment，需写入bucket meta
+	std::deque<std::pair<std::string, std::string>> m_tobe_merge_ranges;	//待合并的key范围[start, end)
 
 	std::deque<fileid_t> m_tobe_delete_bucket_meta_fileids;				//待删除的bucket meta文件
 	fileid_t m_tobe_clean_bucket_meta_fileid;							//待清理的bucket meta文件
+	bool m_base_meta_retained;											//当前全量文件已清理但仍被增量文件依赖，暂不删除
+	std::set<fileid_t> m_cleaned_bucket_meta_fileids;					//已清理过待删除segment文件的bucket meta，删除时不再清理
+
+	std::atomic<uint32_t> m_next_path_index;							//data_paths轮流存放的计数
+	ReaderStat m_rewrite_stat;											//已完成的bottom rewrite，受m_segment_rwlock保护
+	std::atomic<bool> m_bottom_rewrite_pending;							//已通知bottom rewrite但尚未执行完，避免重复抽样
 
 private:		
 	friend class WritableDB;
@@ -0,0 +1,307 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+
+#include <stdlib.h>
+#include "async_file.h"
+
+namespace xfutil
+{
+
+AsyncWritePool::AsyncWritePool()
+{
+	m_thread_num = 0;
+}
+
+AsyncWritePool::~AsyncWritePool()
+{
+	Stop();
+}
+
+void AsyncWritePool::Start(uint16_t thread_num)
+{
+	m_thread_num = thread_num;
+	if(m_thread_num != 0)
+	{
+		m_threads.Start(m_thread_num, WriteThread, this);
+	}
+}
+
+void AsyncWritePool::Stop()
+{
+	if(m_thread_num == 0)
+	{
+		return;
+	}
+	for(uint16_t i = 0; i < m_thread_num; ++i)
+	{
+		m_queue.Push(nullptr);
+	}
+	m_threads.Join();
+	m_thread_num = 0;
+}
+
+void AsyncWritePool::Schedule(AsyncFileWriter* writer)
+{
+	m_queue.Push(writer);
+}
+
+void AsyncWritePool::WriteThread(size_t index, void* arg)
+{
+	AsyncWritePool* pool = (AsyncWritePool*)arg;
+
+	AsyncFileWriter* writer;
+	for(;;)
+	{
+		pool->m_queue.Pop(writer);
+		if(writer == nullptr)
+		{
+			break;
+		}
+		writer->Run();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+AsyncFileWriter::AsyncFileWriter(File& file, BlockPool& pool, RateLimiter& limiter, AsyncWritePool& io_pool, uint32_t max_pending_num)
+	: m_file(file), m_pool(pool), m_limiter(limiter), m_io_pool(io_pool), m_max_pending_num(max_pending_num)
+{
+	m_started = false;
+	m_scheduled = false;
+	m_failed = false;
+
+	m_chunk = nullptr;
+	m_chunk_size = 0;
+	m_chunk_capacity = WRITE_CHUNK_SIZE;
+	m_offset = 0;
+	m_synced_offset = 0;
+	m_bytes_per_sync = 0;
+	m_preallocated = false;
+	m_drop_cache = false;
+	m_dropped_offset = 0;
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	Finish();
+	if(m_chunk != nullptr)
+	{
+		free(m_chunk);
+	}
+}
+
+void AsyncFileWriter::Start(uint64_t offset, uint64_t prealloc_size, uint64_t bytes_per_sync, const char* direct_path)
+{
+	assert(!m_started);
+
+	if(m_chunk == nullptr && posix_memalign((void**)&m_chunk, 4096, WRITE_CHUNK_SIZE) != 0)
+	{
+		m_chunk = nullptr;
+		SetFailed();
+	}
+	m_chunk_size = 0;
+	m_chunk_capacity = WRITE_CHUNK_SIZE - offset % WRITE_CHUNK_SIZE;
+	m_offset = offset;
+	m_synced_offset = offset;
+	m_bytes_per_sync = bytes_per_sync;
+
+	//预分配失败（如文件系统不支持）不影响写入
+	m_preallocated = (prealloc_size != 0 && m_file.Allocate(offset, prealloc_size));
+
+	//文件系统不支持O_DIRECT（如tmpfs）时退化为回写后丢弃page cache
+	m_drop_cache = (direct_path != nullptr && !m_direct_file.Open(direct_path, OF_WRITEONLY|OF_DIRECT));
+	m_dropped_offset = offset;
+
+	m_started = true;
+}
+
+bool AsyncFileWriter::Write(byte_t* block, uint32_t size, const std::string* prefix)
+{
+	assert(m_started && block != nullptr);
+
+	WriteRequest req;
+	req.block = block;
+	req.size = size;
+	if(prefix != nullptr)
+	{
+		req.prefix = *prefix;
+	}
+	//在提交线程按其io优先级限速，避免被限速的写占用共用的io线程
+	if(!Failed())
+	{
+		m_limiter.Request(req.prefix.size() + req.size);
+	}
+
+	if(m_io_pool.ThreadNum() == 0)
+	{
+		Write(req);
+		return !Failed();
+	}
+
+	bool schedule = false;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(m_requests.size() >= m_max_pending_num)
+		{
+			m_cond.wait(lock);
+		}
+		m_requests.push_back(req);
+		if(!m_scheduled)
+		{
+			m_scheduled = true;
+			schedule = true;
+		}
+	}
+	if(schedule)
+	{
+		m_io_pool.Schedule(this);
+	}
+	return !Failed();
+}
+
+//由io线程池调用，每次只处理已提交的请求，之后仍有请求时重新排队，避免一个writer长期占用io线程
+void AsyncFileWriter::Run()
+{
+	size_t cnt;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		cnt = m_requests.size();
+	}
+	for(size_t i = 0; i < cnt; ++i)
+	{
+		WriteRequest req;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			req = m_requests.front();
+			m_requests.pop_front();
+			m_cond.notify_all();
+		}
+		Write(req);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_requests.empty())
+		{
+			m_scheduled = false;
+			m_cond.notify_all();
+			return;
+		}
+	}
+	m_io_pool.Schedule(this);
+}
+
+bool AsyncFileWriter::Finish()
+{
+	if(m_started)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while(m_scheduled)
+			{
+				m_cond.wait(lock);
+			}
+		}
+		FlushChunk();
+		m_started = false;
+
+		//释放预分配但未使用的空间
+		if(m_preallocated && !m_file.Truncate(m_offset))
+		{
+			SetFailed();
+		}
+		m_preallocated = false;
+
+		//io线程按偏移写入，之后的写入从m_offset开始
+		m_direct_file.Close();
+		m_file.Seek(m_offset);
+	}
+	return !Failed();
+}
+
+void AsyncFileWriter::FlushChunk()
+{
+	if(m_chunk_size == 0)
+	{
+		return;
+	}
+	if(!Failed())
+	{
+		//除首尾外的chunk偏移和大小都按WRITE_CHUNK_SIZE对齐，可用O_DIRECT写入，首尾的不完整chunk仍走page cache
+		bool direct = (m_direct_file.GetFD() != INVALID_FD && m_offset % File::DIRECT_IO_ALIGN == 0 && m_chunk_size % File::DIRECT_IO_ALIGN == 0);
+		File& file = direct ? m_direct_file : m_file;
+		if(file.Write(m_offset, m_chunk, m_chunk_size) != m_chunk_size)
+		{
+			SetFailed();
+		}
+	}
+	m_offset += m_chunk_size;
+	m_chunk_size = 0;
+	m_chunk_capacity = WRITE_CHUNK_SIZE;
+
+	if(m_bytes_per_sync != 0 && m_offset - m_synced_offset >= m_bytes_per_sync)
+	{
+		if(m_drop_cache)
+		{
+			DropCache();
+		}
+		m_file.SyncRange(m_synced_offset, m_offset - m_synced_offset);
+		m_synced_offset = m_offset;
+	}
+}
+
+void AsyncFileWriter::DropCache()
+{
+	//上次发起回写的范围此时通常已写完，等待其完成后丢弃，脏页不能被丢弃
+	uint64_t size = m_synced_offset - m_dropped_offset;
+	if(size != 0)
+	{
+		m_file.SyncRange(m_dropped_offset, size, true);
+		m_file.DropCache(m_dropped_offset, size);
+		m_dropped_offset = m_synced_offset;
+	}
+}
+
+void AsyncFileWriter::Append(const byte_t* data, size_t size)
+{
+	while(size != 0)
+	{
+		size_t copy_size = MIN(size, (size_t)(m_chunk_capacity - m_chunk_size));
+		memcpy(m_chunk + m_chunk_size, data, copy_size);
+		m_chunk_size += copy_size;
+		data += copy_size;
+		size -= copy_size;
+
+		if(m_chunk_size == m_chunk_capacity)
+		{
+			FlushChunk();
+		}
+	}
+}
+
+void AsyncFileWriter::Write(const WriteRequest& req)
+{
+	//写失败后不再写入，只释放块
+	if(!Failed())
+	{
+		Append((const byte_t*)req.prefix.data(), req.prefix.size());
+		Append(req.block, req.size);
+	}
+	m_pool.Free(req.block);
+}
+
+}
+
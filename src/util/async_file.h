@@ -0,0 +1,159 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+
+#ifndef __xfutil_async_file_h__
+#define __xfutil_async_file_h__
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include "xfdb/strutil.h"
+#include "file.h"
+#include "block_pool.h"
+#include "rate_limiter.h"
+#include "queue.h"
+#include "thread.h"
+
+namespace xfutil
+{
+
+class AsyncFileWriter;
+
+//AsyncFileWriter共用的io线程池，由Engine持有，线程数固定，不随正在写的文件数增加
+//每个writer同一时刻只由一个线程处理，保证同一文件按提交顺序写入
+class AsyncWritePool
+{
+public:
+	AsyncWritePool();
+	~AsyncWritePool();
+
+public:
+	/**thread_num为0时不启动线程，由提交者直接写入*/
+	void Start(uint16_t thread_num);
+	void Stop();
+
+	inline uint16_t ThreadNum() const
+	{
+		return m_thread_num;
+	}
+
+private:
+	friend class AsyncFileWriter;
+	void Schedule(AsyncFileWriter* writer);
+	static void WriteThread(size_t index, void* arg);
+
+private:
+	uint16_t m_thread_num;
+	BlockingQueue<AsyncFileWriter*> m_queue;	//有待写请求的writer，nullptr表示退出
+	ThreadGroup m_threads;
+
+private:
+	AsyncWritePool(const AsyncWritePool&) = delete;
+	AsyncWritePool& operator=(const AsyncWritePool&) = delete;
+};
+
+//异步顺序写文件：调用者编码完一个块后提交，由io线程池按提交顺序写入，使编码与io并行
+//提交的块由io线程写完后释放回BlockPool，待写的块数达到上限时提交会阻塞
+//io线程将小块合并为按WRITE_CHUNK_SIZE对齐的大块写入，每写入bytes_per_sync字节异步回写一次，使最后的刷盘开销较小
+//注：Start之后、Finish之前不能再直接写同一个文件
+class AsyncFileWriter
+{
+public:
+	AsyncFileWriter(File& file, BlockPool& pool, RateLimiter& limiter, AsyncWritePool& io_pool, uint32_t max_pending_num = 4);
+	~AsyncFileWriter();
+
+public:
+	/**开始写入
+	 * offset: 当前文件大小，之后的写入从此处开始
+	 * prealloc_size: 预计写入的大小，非0时预分配空间，Finish时释放多余的空间
+	 * bytes_per_sync: 每写入多少字节异步回写一次，0不回写
+	 * direct_path: 非空时不占用page cache：对齐的整块另以O_DIRECT打开该文件写入，
+	 *              不支持O_DIRECT时，每次回写时等待上次回写的范围完成并丢弃其page cache
+	 */
+	void Start(uint64_t offset, uint64_t prealloc_size = 0, uint64_t bytes_per_sync = 0, const char* direct_path = nullptr);
+
+	/**提交写请求，block的所有权转给AsyncFileWriter，prefix非空时写在block之前；返回false表示之前的写失败*/
+	bool Write(byte_t* block, uint32_t size, const std::string* prefix = nullptr);
+
+	/**等待已提交的写请求完成，返回是否全部写成功*/
+	bool Finish();
+
+public:
+	static const uint32_t WRITE_CHUNK_SIZE = 1024*1024;
+
+private:
+	struct WriteRequest
+	{
+		byte_t* block;
+		uint32_t size;
+		std::string prefix;
+	};
+
+	friend class AsyncWritePool;
+	void Run();
+	void Write(const WriteRequest& req);
+	void Append(const byte_t* data, size_t size);
+	void FlushChunk();
+	void DropCache();
+
+	inline bool Failed()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_failed;
+	}
+	inline void SetFailed()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_failed = true;
+	}
+
+private:
+	File& m_file;
+	BlockPool& m_pool;
+	RateLimiter& m_limiter;
+	AsyncWritePool& m_io_pool;
+	const uint32_t m_max_pending_num;
+	bool m_started;
+	
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<WriteRequest> m_requests;	//待写的请求
+	bool m_scheduled;						//是否已交给io线程池，为false时m_requests为空
+	bool m_failed;
+
+	//以下只由当前处理该writer的线程访问
+	byte_t* m_chunk;
+	uint32_t m_chunk_size;			//m_chunk中待写的字节数
+	uint32_t m_chunk_capacity;		//本次chunk的容量，保证写入后文件偏移按WRITE_CHUNK_SIZE对齐
+	uint64_t m_offset;				//已写入文件的偏移
+	uint64_t m_synced_offset;		//已发起回写的偏移
+	uint64_t m_bytes_per_sync;
+	bool m_preallocated;
+	bool m_drop_cache;				//是否需要丢弃已回写的page cache
+	uint64_t m_dropped_offset;		//已丢弃page cache的偏移
+	File m_direct_file;				//O_DIRECT方式打开的同一文件
+
+private:
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+};
+
+}
+
+#endif
+
@@ -15,7 +15,9 @@ limitations under the License.
 ***************************************************************************/
 
 #include <vector>
+#include <mutex>
 #include <malloc.h>
+#include <sys/mman.h>
 #include "block_pool.h"
 #include "buffer.h"
 
@@ -24,8 +26,142 @@ namespace xfutil
 {
 
 #define BLOCK_ALGIN		4096
+#define MAX_POOL_SLOT	8
+#define HUGE_PAGE_SIZE	(2*1024*1024)
 
-bool BlockPool::Init(uint32_t block_size, uint32_t cache_num)
+//系统默认大页可能不是2MB，显式指定2MB大页，旧头文件中没有时补充定义
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB	(21 << MAP_HUGE_SHIFT)
+#endif
+
+//槽位登记：内存池销毁时先释放槽位，线程退出时只把弹匣还给仍在槽位上的内存池
+struct PoolSlots
+{
+	std::mutex mutex;
+	BlockPool* pools[MAX_POOL_SLOT] = {nullptr};
+	uint64_t ids[MAX_POOL_SLOT] = {0};
+	uint64_t next_id = 1;
+};
+
+//不析构，保证静态对象析构和线程退出的顺序不影响
+static PoolSlots& GetPoolSlots()
+{
+	static PoolSlots* slots = new PoolSlots;
+	return *slots;
+}
+
+struct ThreadMagazines
+{
+	BlockPool::Magazine mags[MAX_POOL_SLOT];
+
+	ThreadMagazines()
+	{
+		for(int i = 0; i < MAX_POOL_SLOT; ++i)
+		{
+			mags[i].pool_id = 0;
+			mags[i].count = 0;
+		}
+	}
+	~ThreadMagazines()
+	{
+		PoolSlots& slots = GetPoolSlots();
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		for(int i = 0; i < MAX_POOL_SLOT; ++i)
+		{
+			//内存池已销毁时缓存块已随之释放
+			if(mags[i].count != 0 && slots.ids[i] == mags[i].pool_id)
+			{
+				slots.pools[i]->Flush(mags[i], 0);
+			}
+		}
+	}
+};
+
+static thread_local ThreadMagazines s_thread_magazines;
+
+//按2MB大页映射size字节（size已对齐到2MB），失败返回nullptr
+static byte_t* MapHugePage(uint64_t size, HugePageMode& mode)
+{
+	void* ptr = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|MAP_HUGE_2MB, -1, 0);
+	if(ptr != MAP_FAILED)
+	{
+		mode = HUGE_PAGE_HUGETLB;
+		return (byte_t*)ptr;
+	}
+	//没有预留大页时使用透明大页，起始地址需对齐到2MB，多映射一页后裁掉首尾
+	ptr = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(ptr == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	byte_t* start = (byte_t*)ptr;
+	byte_t* aligned = (byte_t*)(((uintptr_t)start + HUGE_PAGE_SIZE - 1) & ~((uintptr_t)HUGE_PAGE_SIZE - 1));
+	if(aligned != start)
+	{
+		munmap(start, aligned - start);
+	}
+	byte_t* end = start + size + HUGE_PAGE_SIZE;
+	if(end != aligned + size)
+	{
+		munmap(aligned + size, end - (aligned + size));
+	}
+	mode = (madvise(aligned, size, MADV_HUGEPAGE) == 0) ? HUGE_PAGE_THP : HUGE_PAGE_NONE;
+	return aligned;
+}
+
+constexpr uint32_t BlockPool::MAX_MAGAZINE_SIZE;
+
+BlockPool::BlockPool()
+{
+	spinlock_init(&m_lock);
+	
+	m_block_size = 0;
+	m_cache_num = 0;
+	m_cache_start = nullptr;
+	m_cache_end = nullptr;
+	m_map_size = 0;
+	m_huge_page = HUGE_PAGE_NONE;
+
+	m_slot = -1;
+	m_magazine_size = 0;
+	m_exhausted_num = 0;
+	m_overflow_num = 0;
+
+	PoolSlots& slots = GetPoolSlots();
+	std::lock_guard<std::mutex> lock(slots.mutex);
+	m_id = slots.next_id++;
+}
+
+BlockPool::~BlockPool()
+{
+	if(m_slot >= 0)
+	{
+		PoolSlots& slots = GetPoolSlots();
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		slots.pools[m_slot] = nullptr;
+		slots.ids[m_slot] = 0;
+	}
+	if(m_cache_start != nullptr)
+	{
+		if(m_map_size != 0)
+		{
+			munmap(m_cache_start, m_map_size);
+		}
+		else
+		{
+			xfree(m_cache_start);
+		}
+		m_cache_start = nullptr;
+		m_cache_end = nullptr;
+	}
+	
+	spinlock_destroy(&m_lock);
+}
+
+bool BlockPool::Init(uint32_t block_size, uint32_t cache_num, bool huge_page/* = false*/)
 {
 	assert(block_size % BLOCK_ALGIN == 0);
 	if(block_size < BLOCK_ALGIN || block_size % BLOCK_ALGIN != 0)
@@ -39,50 +175,160 @@ bool BlockPool::Init(uint32_t block_size, uint32_t cache_num)
 	}
 	
 	uint64_t size = (uint64_t)block_size * cache_num;
-	byte_t* buf = xmalloc(size);
+	byte_t* buf = nullptr;
+	if(huge_page && size != 0)
+	{
+		uint64_t map_size = (size + HUGE_PAGE_SIZE - 1) & ~(uint64_t)(HUGE_PAGE_SIZE - 1);
+		buf = MapHugePage(map_size, m_huge_page);
+		if(buf != nullptr)
+		{
+			m_map_size = map_size;
+		}
+	}
 	if(buf == nullptr)
 	{
-		return false;
+		buf = xmalloc(size);
+		if(buf == nullptr)
+		{
+			return false;
+		}
 	}
 	m_block_size = block_size;
+	m_cache_num = cache_num;
 	m_cache_start = buf;
 	m_cache_end = buf + size;
-	for(uint32_t i = 0; i < cache_num; ++i)
+	m_free_blocks.reserve(cache_num);
+	//倒序放入，先分配低地址的块
+	for(uint32_t i = cache_num; i > 0; --i)
 	{
-		m_free_blocks.push_back(buf);
-		buf += block_size;
+		m_free_blocks.push_back(buf + (uint64_t)(i-1) * block_size);
+	}
+
+	//弹匣总共最多占缓存块的一小部分，避免各线程囤积导致缓存块用尽
+	m_magazine_size = MIN(MAX_MAGAZINE_SIZE, cache_num / 128);
+	if(m_magazine_size >= 2)
+	{
+		PoolSlots& slots = GetPoolSlots();
+		std::lock_guard<std::mutex> lock(slots.mutex);
+		for(int i = 0; i < MAX_POOL_SLOT; ++i)
+		{
+			if(slots.pools[i] == nullptr)
+			{
+				slots.pools[i] = this;
+				slots.ids[i] = m_id;
+				m_slot = i;
+				break;
+			}
+		}
 	}
 	return true;
 }
 
+BlockPool::Magazine* BlockPool::GetMagazine()
+{
+	if(m_slot < 0)
+	{
+		return nullptr;
+	}
+	Magazine& mag = s_thread_magazines.mags[m_slot];
+	if(mag.pool_id != m_id)
+	{
+		//槽位只在原内存池销毁后复用，残留的块已释放
+		mag.pool_id = m_id;
+		mag.count = 0;
+	}
+	return &mag;
+}
+
+void BlockPool::Refill(Magazine& mag)
+{
+	assert(mag.count == 0);
+	uint32_t num = m_magazine_size / 2;
+
+	SpinLockGuard guard(m_lock);
+	while(mag.count < num && !m_free_blocks.empty())
+	{
+		mag.blocks[mag.count++] = m_free_blocks.back();
+		m_free_blocks.pop_back();
+	}
+}
+
+void BlockPool::Flush(Magazine& mag, uint32_t keep_num)
+{
+	SpinLockGuard guard(m_lock);
+	while(mag.count > keep_num)
+	{
+		m_free_blocks.push_back(mag.blocks[--mag.count]);
+	}
+}
+
+byte_t* BlockPool::AllocFromSystem()
+{
+	m_exhausted_num.fetch_add(1, std::memory_order_relaxed);
+	byte_t* block = xmalloc(m_block_size);
+	if(block != nullptr)
+	{
+		m_overflow_num.fetch_add(1, std::memory_order_relaxed);
+	}
+	return block;
+}
+
 byte_t* BlockPool::Alloc()
 {
+	Magazine* mag = GetMagazine();
+	if(mag != nullptr)
+	{
+		if(mag->count == 0)
+		{
+			Refill(*mag);
+		}
+		if(mag->count != 0)
+		{
+			return mag->blocks[--mag->count];
+		}
+		return AllocFromSystem();
+	}
 	{
 		SpinLockGuard guard(m_lock);
 		if(!m_free_blocks.empty())
 		{
-			byte_t* buf = m_free_blocks.front();
-			m_free_blocks.pop_front();
+			byte_t* buf = m_free_blocks.back();
+			m_free_blocks.pop_back();
 			return buf;
 		}
 	}
-	return xmalloc(m_block_size);
+	return AllocFromSystem();
 }
 
 void BlockPool::Free(byte_t* block)
 {
+	if(!IsCached(block))
 	{
-		SpinLockGuard guard(m_lock);
-		if(block >= m_cache_start && block < m_cache_end)
+		if(block != nullptr)
+		{
+			m_overflow_num.fetch_sub(1, std::memory_order_relaxed);
+		}
+		xfree(block);
+		return;
+	}
+	Magazine* mag = GetMagazine();
+	if(mag != nullptr)
+	{
+		if(mag->count == m_magazine_size)
 		{
-			m_free_blocks.push_front(block);
-			return;
+			Flush(*mag, m_magazine_size / 2);
 		}
+		mag->blocks[mag->count++] = block;
+		return;
 	}
-	xfree(block);
+	SpinLockGuard guard(m_lock);
+	m_free_blocks.push_back(block);
 }
-	
 
+uint32_t BlockPool::FreeNum()
+{
+	SpinLockGuard guard(m_lock);
+	return m_free_blocks.size();
 }
 
-
+}
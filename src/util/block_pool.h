@@ -17,43 +17,36 @@ limitations under the License.
 #ifndef __xfutil_block_pool_h__
 #define __xfutil_block_pool_h__
 
-#include <deque>
+#include <vector>
+#include <atomic>
 #include "xfdb/strutil.h"
 #include "spinlock.h"
 
 namespace xfutil
 {
 
+enum HugePageMode : uint8_t
+{
+	HUGE_PAGE_NONE = 0,
+	HUGE_PAGE_HUGETLB,		//MAP_HUGETLB，使用预留的大页
+	HUGE_PAGE_THP,			//madvise(MADV_HUGEPAGE)，由内核合并为透明大页
+};
+
 //大块内存池>=4096
+//每个线程有自己的空闲块弹匣，申请/释放只在弹匣空/满时才加锁与全局空闲块批量交换一半
 class BlockPool
 {
 public:
-	BlockPool()
-	{
-		spinlock_init(&m_lock);
-		
-		m_block_size = 0;
-		m_cache_start = nullptr;
-		m_cache_end = nullptr;
-	}
-	~BlockPool()
-	{
-		if(m_cache_start != nullptr)
-		{
-			xfree(m_cache_start);
-			m_cache_start = nullptr;
-			m_cache_end = nullptr;
-		}
-		
-		spinlock_destroy(&m_lock);
-	}
+	BlockPool();
+	~BlockPool();
 	
 public:
 	/**初始化内存块池
 	 * block_size: 块大小，需对齐到4096
 	 * cache_num: 缓存块的数量
+	 * huge_page: 缓存块使用2MB大页，MAP_HUGETLB失败时使用透明大页
 	 */
-	bool Init(uint32_t block_size, uint32_t cache_num);
+	bool Init(uint32_t block_size, uint32_t cache_num, bool huge_page = false);
 	
 	/**申请一个块，如果失败，返回nullptr*/
 	byte_t* Alloc();
@@ -66,12 +59,73 @@ public:
 	{
 		return m_block_size;
 	}
+
+	/**缓存块的数量*/
+	inline uint32_t CacheNum() const
+	{
+		return m_cache_num;
+	}
+	/**全局空闲的缓存块数，不含各线程弹匣中的块*/
+	uint32_t FreeNum();
+	/**缓存块用尽后从系统申请的累计次数*/
+	inline uint64_t ExhaustedNum() const
+	{
+		return m_exhausted_num.load(std::memory_order_relaxed);
+	}
+	/**当前未释放的从系统申请的块数*/
+	inline uint64_t OverflowNum() const
+	{
+		return m_overflow_num.load(std::memory_order_relaxed);
+	}
+	/**占用的内存：缓存块+未释放的从系统申请的块*/
+	inline uint64_t MemorySize() const
+	{
+		uint64_t cache_size = (m_map_size != 0) ? m_map_size : (uint64_t)(m_cache_end - m_cache_start);
+		return cache_size + OverflowNum() * m_block_size;
+	}
+	/**缓存块的大页方式*/
+	inline HugePageMode HugePage() const
+	{
+		return m_huge_page;
+	}
+
+private:
+	static constexpr uint32_t MAX_MAGAZINE_SIZE = 16;
+
+	struct Magazine
+	{
+		uint64_t pool_id;		//所属内存池，与槽位当前的内存池不同时为已销毁内存池的残留
+		uint32_t count;
+		byte_t* blocks[MAX_MAGAZINE_SIZE];
+	};
+
+	inline bool IsCached(const byte_t* block) const
+	{
+		return block >= m_cache_start && block < m_cache_end;
+	}
+	Magazine* GetMagazine();
+	void Refill(Magazine& mag);
+	void Flush(Magazine& mag, uint32_t keep_num);
+	byte_t* AllocFromSystem();
+
+	friend struct ThreadMagazines;
+
 private:
 	spinlock_t m_lock;
 	uint32_t m_block_size;
+	uint32_t m_cache_num;
 	byte_t* m_cache_start;
 	byte_t* m_cache_end;
-	std::deque<byte_t*> m_free_blocks;
+	uint64_t m_map_size;					//缓存块为mmap时的映射大小，否则为0
+	HugePageMode m_huge_page;
+	std::vector<byte_t*> m_free_blocks;		//全局空闲块，后进先出
+
+	uint64_t m_id;							//进程内唯一，不复用
+	int m_slot;								//线程弹匣槽位，无空闲槽位或未初始化时为-1，此时每次加锁
+	uint32_t m_magazine_size;				//弹匣容量
+
+	std::atomic<uint64_t> m_exhausted_num;
+	std::atomic<uint64_t> m_overflow_num;
 	
 private:
 	BlockPool(const BlockPool&) = delete;
@@ -23,6 +23,8 @@ limitations under the License.
 #include <sys/stat.h>
 #include <fcntl.h>
 #include "buffer.h"
+#include "rate_limiter.h"
+#include "path.h"
 
 namespace xfutil 
 {
@@ -51,6 +53,7 @@ bool File::Open(const char* file_path, uint32_t flags)
 	if(flags & OF_APPEND)	f |= O_APPEND;
 	if(flags & OF_TRUNCATE)	f |= O_TRUNC;
 	if(flags & OF_CREATE)	f |= O_CREAT;
+	if(flags & OF_DIRECT)	f |= O_DIRECT;
 
     
 	mode_t old_mask = umask(0);
@@ -62,7 +65,7 @@ bool File::Open(const char* file_path, uint32_t flags)
 
 //SetFilePointerEx() followed by SetEndOfFile()
 	
-bool File::Copy(const char *src_filepath, const char *dst_filepath, bool sync/* = false*/)
+bool File::Copy(const char *src_filepath, const char *dst_filepath, bool sync/* = false*/, RateLimiter* limiter/* = nullptr*/)
 {
     File src_file;
     if(!src_file.Open(src_filepath, OF_READONLY))
@@ -91,6 +94,10 @@ bool File::Copy(const char *src_filepath, const char *dst_filepath, bool sync/*
         {
             break;
         }
+        if(limiter != nullptr)
+        {
+            limiter->Request(read_size);
+        }
         if(dst_file.Write(buf.Buffer(), read_size) != read_size)
         {
             return false;
@@ -103,6 +110,112 @@ bool File::Copy(const char *src_filepath, const char *dst_filepath, bool sync/*
     }
     return true;
 }	
+bool FileMapping::Map(const File& file, int advice)
+{
+	assert(m_data == nullptr);
+	int64_t size = file.Size();
+	if(size <= 0)
+	{
+		return false;
+	}
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, file.GetFD(), 0);
+	if(data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_data = (byte_t*)data;
+	m_size = size;
+
+	if(advice != MADV_NORMAL)
+	{
+		madvise(m_data, m_size, advice);
+	}
+	return true;
+}
+
+void FileMapping::Unmap()
+{
+	if(m_data != nullptr)
+	{
+		munmap(m_data, m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
+bool FileMapping::Advise(uint64_t offset, uint64_t size, int advice) const
+{
+	if(offset >= m_size)
+	{
+		return false;
+	}
+	//madvise的起始地址需按页对齐
+	static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+	uint64_t start = offset & ~(page_size - 1);
+	uint64_t end = MIN(offset + size, m_size);
+	return madvise(m_data + start, end - start, advice) == 0;
+}
+
+bool SharedMemory::Open(const char* file_path, uint64_t size, bool writable, const std::function<void(byte_t*)>& init)
+{
+	assert(m_data == nullptr);
+	File file;
+	if(!file.Open(file_path, writable ? OF_READWRITE : OF_READONLY))
+	{
+		if(LastError != ENOENT)
+		{
+			return false;
+		}
+		//先在临时文件的映射上初始化再link到目标路径，保证其他进程看到的文件已初始化
+		char tmp_path[MAX_PATH_LEN];
+		snprintf(tmp_path, sizeof(tmp_path), "%s.%d", file_path, getpid());
+		File tmp_file;
+		if(!tmp_file.Open(tmp_path, OF_READWRITE|OF_CREATE|OF_TRUNCATE))
+		{
+			return false;
+		}
+		bool ok = tmp_file.Truncate(size);
+		if(ok && init)
+		{
+			void* data = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, tmp_file.GetFD(), 0);
+			ok = (data != MAP_FAILED);
+			if(ok)
+			{
+				init((byte_t*)data);
+				munmap(data, size);
+			}
+		}
+		ok = ok && (link(tmp_path, file_path) == 0 || LastError == EEXIST);
+		File::Remove(tmp_path);
+		if(!ok || !file.Open(file_path, writable ? OF_READWRITE : OF_READONLY))
+		{
+			return false;
+		}
+	}
+	if(file.Size() != (int64_t)size)
+	{
+		return false;
+	}
+	void* data = mmap(nullptr, size, writable ? (PROT_READ|PROT_WRITE) : PROT_READ, MAP_SHARED, file.GetFD(), 0);
+	if(data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_data = (byte_t*)data;
+	m_size = size;
+	return true;
+}
+
+void SharedMemory::Close()
+{
+	if(m_data != nullptr)
+	{
+		munmap(m_data, m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
+
 } 
 
 
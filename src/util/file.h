@@ -18,6 +18,7 @@ limitations under the License.
 #define __xfutil_file_h__
 
 #include <memory>
+#include <functional>
 #include <ctime>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -25,11 +26,14 @@ limitations under the License.
 #include <unistd.h>
 #include <sys/file.h>
 #include <sys/uio.h>
+#include <sys/mman.h>
 #include "xfdb/strutil.h"
 
 namespace xfutil 
 {
 
+class RateLimiter;
+
 enum
 {
 	OF_READONLY = 0x0001,
@@ -39,6 +43,7 @@ enum
 	OF_CREATE = 0x0010,			//不存在时则创建
 	OF_APPEND = 0x0020,			//追加文件写
 	OF_TRUNCATE = 0x0040,		//文件存在+写方式时，文件截断为0
+	OF_DIRECT = 0x0080,			//O_DIRECT，绕过page cache，读写的缓冲区、偏移和大小需按File::DIRECT_IO_ALIGN对齐
 };
 
 enum LockFlag : uint8_t
@@ -76,8 +81,11 @@ public:
 	File();
 	~File();
 	
+public:
+	static const uint32_t DIRECT_IO_ALIGN = 4096;
+
 public:	
-	inline fd_t GetFD()
+	inline fd_t GetFD() const
 	{
 		return m_fd;
 	}
@@ -156,13 +164,34 @@ public:
 	{
 		return fsync(m_fd) == 0;
 	}
+	inline bool DataSync()
+	{
+		return fdatasync(m_fd) == 0;
+	}
+	/**回写[offset, offset+size)范围内的脏页，wait为false时不等待完成*/
+	inline bool SyncRange(uint64_t offset, uint64_t size, bool wait = false)
+	{
+		unsigned int flags = wait ? (SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER) : SYNC_FILE_RANGE_WRITE;
+		return sync_file_range(m_fd, offset, size, flags) == 0;
+	}
+	/**异步预读[offset, offset+size)范围到page cache，不等待完成*/
+	inline bool Prefetch(uint64_t offset, uint64_t size) const
+	{
+		return posix_fadvise(m_fd, offset, size, POSIX_FADV_WILLNEED) == 0;
+	}
+	/**丢弃[offset, offset+size)范围内干净的page cache，size为0表示到文件尾*/
+	inline bool DropCache(uint64_t offset, uint64_t size) const
+	{
+		return posix_fadvise(m_fd, offset, size, POSIX_FADV_DONTNEED) == 0;
+	}
 	inline bool Truncate(size_t new_size)
 	{
 		return ftruncate(m_fd, new_size) == 0;
 	}
-	inline bool Allocate(size_t size)
+	/**预分配空间，不改变文件大小*/
+	inline bool Allocate(uint64_t offset, uint64_t size)
 	{
-		return fallocate(m_fd, 0, 0, size);
+		return fallocate(m_fd, FALLOC_FL_KEEP_SIZE, offset, size) == 0;
 	}
 	
 	inline bool Seek(int64_t offset)
@@ -213,7 +242,8 @@ public:
 	{
 		return rename(src_filepath, dst_filepath) == 0;
 	}
-	static bool Copy(const char *src_filepath, const char *dst_filepath, bool sync = false);
+	/**limiter非空时，按当前线程的io优先级限速*/
+	static bool Copy(const char *src_filepath, const char *dst_filepath, bool sync = false, RateLimiter* limiter = nullptr);
 
 
 protected:
@@ -224,6 +254,92 @@ private:
 	File& operator=(const File&) = delete;
 };
 
+//只读映射整个文件，文件映射期间不能被修改
+class FileMapping
+{
+public:
+	FileMapping()
+	{
+		m_data = nullptr;
+		m_size = 0;
+	}
+	~FileMapping()
+	{
+		Unmap();
+	}
+
+public:
+	/**advice: madvise提示，如MADV_RANDOM、MADV_SEQUENTIAL*/
+	bool Map(const File& file, int advice = MADV_NORMAL);
+	void Unmap();
+
+	/**对[offset, offset+size)范围设置madvise提示*/
+	bool Advise(uint64_t offset, uint64_t size, int advice) const;
+
+	inline bool Mapped() const
+	{
+		return m_data != nullptr;
+	}
+	inline const byte_t* Data() const
+	{
+		return m_data;
+	}
+	inline uint64_t Size() const
+	{
+		return m_size;
+	}
+
+private:
+	byte_t* m_data;
+	uint64_t m_size;
+
+private:
+	FileMapping(const FileMapping&) = delete;
+	FileMapping& operator=(const FileMapping&) = delete;
+};
+
+//共享映射整个文件，用于进程间共享内存
+class SharedMemory
+{
+public:
+	SharedMemory()
+	{
+		m_data = nullptr;
+		m_size = 0;
+	}
+	~SharedMemory()
+	{
+		Close();
+	}
+
+public:
+	/**映射file_path，不存在时创建大小为size的文件，映射后调用init在共享内存中初始化，
+	   多个进程同时创建时只有一个生效；已存在的文件大小不为size时失败；writable为false时只读映射*/
+	bool Open(const char* file_path, uint64_t size, bool writable, const std::function<void(byte_t*)>& init = nullptr);
+	void Close();
+
+	inline bool Opened() const
+	{
+		return m_data != nullptr;
+	}
+	inline byte_t* Data() const
+	{
+		return m_data;
+	}
+	inline uint64_t Size() const
+	{
+		return m_size;
+	}
+
+private:
+	byte_t* m_data;
+	uint64_t m_size;
+
+private:
+	SharedMemory(const SharedMemory&) = delete;
+	SharedMemory& operator=(const SharedMemory&) = delete;
+};
+
 } 
 
 #endif
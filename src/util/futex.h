@@ -0,0 +1,50 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#ifndef __xfutil_futex_h__
+#define __xfutil_futex_h__
+
+#include <atomic>
+#include <climits>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace xfutil
+{
+
+//futex可位于进程间共享内存中，因此不使用FUTEX_PRIVATE_FLAG
+
+/**addr等于val时等待，直到被唤醒或超时*/
+static inline void FutexWait(const std::atomic<uint32_t>* addr, uint32_t val, uint32_t timeout_ms)
+{
+	struct timespec ts;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+	syscall(SYS_futex, (const uint32_t*)addr, FUTEX_WAIT, val, &ts, nullptr, 0);
+}
+
+/**唤醒所有等待在addr上的线程，包括其他进程中的*/
+static inline void FutexWakeAll(const std::atomic<uint32_t>* addr)
+{
+	syscall(SYS_futex, (const uint32_t*)addr, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+}
+
+#endif
+
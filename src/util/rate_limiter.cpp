@@ -0,0 +1,208 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#include <chrono>
+#include "rate_limiter.h"
+
+namespace xfutil
+{
+
+//等待令牌的最长间隔
+#define REFILL_INTERVAL_MS		10
+//最多积攒100ms的令牌
+#define MAX_BURST_MS			100
+//自动调整的间隔
+#define TUNE_INTERVAL_US		(1000*1000)
+
+static thread_local IOPriority s_thread_priority = IO_PRIORITY_USER;
+
+RateLimiter::RateLimiter()
+{
+	m_max_rate = 0;
+	m_rate = 0;
+	m_available = 0;
+	m_last_refill_us = 0;
+	for(int i = 0; i < IO_PRIORITY_MAX; ++i)
+	{
+		m_waiter_num[i] = 0;
+		m_total_bytes[i] = 0;
+	}
+	m_auto_tune = false;
+	m_last_tune_us = 0;
+	m_base_latency_us = 0;
+	m_latency_sum = 0;
+	m_latency_count = 0;
+}
+
+void RateLimiter::Init(uint64_t bytes_per_s, bool auto_tune)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_max_rate = bytes_per_s;
+	m_rate = bytes_per_s;
+	m_available = 0;
+	m_last_refill_us = NowUs();
+	m_auto_tune = auto_tune;
+	m_last_tune_us = m_last_refill_us;
+}
+
+uint64_t RateLimiter::NowUs()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+IOPriority RateLimiter::GetThreadPriority()
+{
+	return s_thread_priority;
+}
+
+void RateLimiter::SetThreadPriority(IOPriority priority)
+{
+	assert(priority < IO_PRIORITY_MAX);
+	s_thread_priority = priority;
+}
+
+bool RateLimiter::HasHigherWaiter(IOPriority priority) const
+{
+	for(int i = IO_PRIORITY_HIGH; i < priority; ++i)
+	{
+		if(m_waiter_num[i] != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void RateLimiter::Refill(uint64_t now_us)
+{
+	if(now_us <= m_last_refill_us)
+	{
+		return;
+	}
+	//长时间空闲时，也只积攒MAX_BURST_MS的令牌
+	uint64_t elapsed_us = MIN(now_us - m_last_refill_us, 1000*1000ULL);
+	uint64_t rate = m_rate;
+	uint64_t tokens = rate * elapsed_us / (1000*1000);
+	if(tokens == 0)
+	{
+		return;
+	}
+	m_last_refill_us = now_us;
+
+	int64_t max_burst = MAX(rate * MAX_BURST_MS / 1000, 1ULL);
+	m_available += tokens;
+	if(m_available > max_burst)
+	{
+		m_available = max_burst;
+	}
+}
+
+void RateLimiter::Tune(uint64_t now_us)
+{
+	if(now_us < m_last_tune_us + TUNE_INTERVAL_US)
+	{
+		return;
+	}
+	m_last_tune_us = now_us;
+
+	uint64_t count = m_latency_count.exchange(0);
+	uint64_t sum = m_latency_sum.exchange(0);
+	uint64_t rate = m_rate;
+	//最低不低于上限的1/16
+	const uint64_t min_rate = MAX(m_max_rate / 16, 1ULL);
+
+	if(count == 0)
+	{
+		//无前台读，逐步恢复
+		rate += rate / 8;
+	}
+	else
+	{
+		uint64_t avg_latency_us = sum / count;
+		if(m_base_latency_us == 0 || avg_latency_us < m_base_latency_us)
+		{
+			m_base_latency_us = avg_latency_us;
+		}
+		else
+		{
+			//基准值缓慢跟随，避免长期偏低
+			m_base_latency_us += (avg_latency_us - m_base_latency_us) / 16;
+		}
+
+		if(avg_latency_us > m_base_latency_us * 2)
+		{
+			rate -= rate / 4;
+		}
+		else if(avg_latency_us < m_base_latency_us * 3 / 2)
+		{
+			rate += rate / 16;
+		}
+	}
+	if(rate < min_rate)
+	{
+		rate = min_rate;
+	}
+	else if(rate > m_max_rate)
+	{
+		rate = m_max_rate;
+	}
+	m_rate = rate;
+}
+
+void RateLimiter::Request(uint64_t size, IOPriority priority)
+{
+	if(m_max_rate == 0 || priority == IO_PRIORITY_USER)
+	{
+		return;
+	}
+	assert(priority < IO_PRIORITY_MAX);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	++m_waiter_num[priority];
+	while(size > 0)
+	{
+		uint64_t now_us = NowUs();
+		Refill(now_us);
+		if(m_auto_tune)
+		{
+			Tune(now_us);
+		}
+		if(m_available > 0 && !HasHigherWaiter(priority))
+		{
+			uint64_t granted = MIN(size, (uint64_t)m_available);
+			m_available -= granted;
+			m_total_bytes[priority] += granted;
+			size -= granted;
+			continue;
+		}
+		m_cond.wait_for(lock, std::chrono::milliseconds(REFILL_INTERVAL_MS));
+	}
+	--m_waiter_num[priority];
+	m_cond.notify_all();
+}
+
+void RateLimiter::ReportLatency(uint64_t latency_us)
+{
+	if(!m_auto_tune)
+	{
+		return;
+	}
+	m_latency_sum += latency_us;
+	++m_latency_count;
+}
+
+}
+
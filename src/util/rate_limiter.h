@@ -0,0 +1,166 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#ifndef __xfutil_rate_limiter_h__
+#define __xfutil_rate_limiter_h__
+
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "xfdb/strutil.h"
+
+namespace xfutil
+{
+
+//io优先级，值越小优先级越高
+enum IOPriority : uint8_t
+{
+	IO_PRIORITY_USER = 0,		//前台读写，不限速
+	IO_PRIORITY_HIGH,			//flush
+	IO_PRIORITY_MID,			//merge
+	IO_PRIORITY_LOW,			//backup
+	IO_PRIORITY_MAX,
+};
+
+//令牌桶限速器，有等待的高优先级请求时，低优先级请求不会获得令牌
+class RateLimiter
+{
+public:
+	RateLimiter();
+	~RateLimiter()
+	{}
+
+public:
+	/**bytes_per_s为0表示不限速，auto_tune表示根据前台读延时自动调整速率*/
+	void Init(uint64_t bytes_per_s, bool auto_tune);
+
+	/**申请size字节的令牌，不足时阻塞*/
+	void Request(uint64_t size, IOPriority priority);
+
+	/**以当前线程的优先级申请令牌*/
+	inline void Request(uint64_t size)
+	{
+		Request(size, GetThreadPriority());
+	}
+
+	/**上报前台读的耗时，单位微秒*/
+	void ReportLatency(uint64_t latency_us);
+
+	inline bool Enabled() const
+	{
+		return m_max_rate != 0;
+	}
+	inline bool AutoTune() const
+	{
+		return m_auto_tune;
+	}
+	/**当前速率，单位字节/秒*/
+	inline uint64_t Rate() const
+	{
+		return m_rate;
+	}
+	inline uint64_t TotalBytes(IOPriority priority) const
+	{
+		return m_total_bytes[priority];
+	}
+
+	static IOPriority GetThreadPriority();
+	static void SetThreadPriority(IOPriority priority);
+
+	static uint64_t NowUs();
+
+private:
+	void Refill(uint64_t now_us);
+	void Tune(uint64_t now_us);
+	bool HasHigherWaiter(IOPriority priority) const;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+
+	uint64_t m_max_rate;
+	std::atomic<uint64_t> m_rate;
+	int64_t m_available;
+	uint64_t m_last_refill_us;
+
+	uint32_t m_waiter_num[IO_PRIORITY_MAX];
+	uint64_t m_total_bytes[IO_PRIORITY_MAX];
+
+	//自动调整
+	bool m_auto_tune;
+	uint64_t m_last_tune_us;
+	uint64_t m_base_latency_us;
+	std::atomic<uint64_t> m_latency_sum;
+	std::atomic<uint64_t> m_latency_count;
+
+private:
+	RateLimiter(const RateLimiter&) = delete;
+	RateLimiter& operator=(const RateLimiter&) = delete;
+};
+
+//设置当前线程的io优先级，析构时恢复
+class IOPriorityGuard
+{
+public:
+	explicit IOPriorityGuard(IOPriority priority)
+	{
+		m_old_priority = RateLimiter::GetThreadPriority();
+		RateLimiter::SetThreadPriority(priority);
+	}
+	~IOPriorityGuard()
+	{
+		RateLimiter::SetThreadPriority(m_old_priority);
+	}
+
+private:
+	IOPriority m_old_priority;
+
+private:
+	IOPriorityGuard(const IOPriorityGuard&) = delete;
+	IOPriorityGuard& operator=(const IOPriorityGuard&) = delete;
+};
+
+//读io前申请令牌，前台读则在析构时上报耗时
+class IOReadGuard
+{
+public:
+	IOReadGuard(RateLimiter& limiter, uint64_t size) : m_limiter(limiter)
+	{
+		IOPriority priority = RateLimiter::GetThreadPriority();
+		limiter.Request(size, priority);
+		m_start_us = (priority == IO_PRIORITY_USER && limiter.AutoTune()) ? RateLimiter::NowUs() : 0;
+	}
+	~IOReadGuard()
+	{
+		if(m_start_us != 0)
+		{
+			m_limiter.ReportLatency(RateLimiter::NowUs() - m_start_us);
+		}
+	}
+
+private:
+	RateLimiter& m_limiter;
+	uint64_t m_start_us;
+
+private:
+	IOReadGuard(const IOReadGuard&) = delete;
+	IOReadGuard& operator=(const IOReadGuard&) = delete;
+};
+
+}
+
+#endif
+
@@ -0,0 +1,282 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#include <cstring>
+#include <cerrno>
+#include "shared_cache.h"
+#include "hash.h"
+
+namespace xfutil 
+{
+
+#define SHARED_CACHE_MAGIC		0x43534658	//"XFSC"
+#define SHARED_CACHE_VERSION	1
+
+#define SHARED_CACHE_WAYS		8			//每个索引桶的项数
+#define MAX_SHARED_CACHE_SHARDS	16
+#define AVG_ENTRY_SIZE			1024		//按此估算索引项数
+#define SHARED_CACHE_ALIGN		8
+
+struct SharedCache::Header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t shard_num;
+	uint32_t reserved;
+	uint64_t bucket_num;
+	uint64_t data_size;
+};
+
+//每片单独占用cache line
+struct alignas(64) SharedCache::Shard
+{
+	pthread_mutex_t mutex;
+	uint64_t write_pos;		//数据区的逻辑写位置，只增不减，[write_pos-data_size, write_pos)内的数据有效
+};
+
+struct SharedCache::IndexEntry
+{
+	uint64_t tag;			//key的hash，0表示空
+	uint64_t pos;			//数据的逻辑位置
+};
+
+//数据区中的项
+struct EntryHead
+{
+	uint64_t tag;
+	uint32_t key_size;
+	uint32_t value_size;
+};
+
+static inline uint64_t HashTag(const std::string& key)
+{
+	uint64_t h1 = Hash32((const byte_t*)key.data(), key.size());
+	uint64_t h2 = Hash32((const byte_t*)key.data(), key.size(), 2654435761U);
+	return ((h1 << 32) | h2) | 1;
+}
+
+static inline uint64_t AlignUp(uint64_t size)
+{
+	return (size + SHARED_CACHE_ALIGN - 1) & ~(uint64_t)(SHARED_CACHE_ALIGN - 1);
+}
+
+//头部占第1个cache line，之后是各片
+static inline uint64_t HeadSize(uint32_t shard_num)
+{
+	return 64 + (uint64_t)shard_num * 64;
+}
+
+SharedCache::SharedCache()
+{
+	m_shard_num = 0;
+	m_bucket_num = 0;
+	m_data_size = 0;
+}
+
+SharedCache::~SharedCache()
+{
+}
+
+void SharedCache::GetLayout(size_t max_size, uint32_t& shard_num, uint64_t& bucket_num, uint64_t& data_size)
+{
+	shard_num = MAX_SHARED_CACHE_SHARDS;
+	while(shard_num > 1 && max_size / shard_num < MB(1))
+	{
+		shard_num /= 2;
+	}
+	data_size = AlignUp(max_size / shard_num);
+	bucket_num = MAX(data_size / AVG_ENTRY_SIZE / SHARED_CACHE_WAYS, 1);
+}
+
+bool SharedCache::Open(const char* file_path, size_t max_size)
+{
+	static_assert(sizeof(Header) <= 64 && sizeof(Shard) == 64, "shared cache layout");
+	uint32_t shard_num;
+	uint64_t bucket_num, data_size;
+	GetLayout(max_size, shard_num, bucket_num, data_size);
+
+	uint64_t head_size = HeadSize(shard_num);
+	uint64_t index_size = (uint64_t)shard_num * bucket_num * SHARED_CACHE_WAYS * sizeof(IndexEntry);
+	uint64_t file_size = head_size + index_size + (uint64_t)shard_num * data_size;
+
+	//在映射的共享内存中初始化进程间互斥锁，magic最后写入，索引和数据区为0即为空
+	auto init = [=](byte_t* data)
+	{
+		Header* header = (Header*)data;
+		header->version = SHARED_CACHE_VERSION;
+		header->shard_num = shard_num;
+		header->bucket_num = bucket_num;
+		header->data_size = data_size;
+
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+		for(uint32_t i = 0; i < shard_num; ++i)
+		{
+			Shard* shard = (Shard*)(data + HeadSize(0) + i * 64);
+			pthread_mutex_init(&shard->mutex, &attr);
+			shard->write_pos = data_size;
+		}
+		pthread_mutexattr_destroy(&attr);
+
+		__atomic_store_n(&header->magic, SHARED_CACHE_MAGIC, __ATOMIC_RELEASE);
+	};
+	if(!m_shm.Open(file_path, file_size, true, init))
+	{
+		return false;
+	}
+	Header* header = (Header*)m_shm.Data();
+	if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHARED_CACHE_MAGIC || header->version != SHARED_CACHE_VERSION 
+		|| header->shard_num != shard_num || header->bucket_num != bucket_num || header->data_size != data_size)
+	{
+		m_shm.Close();
+		return false;
+	}
+	m_shard_num = shard_num;
+	m_bucket_num = bucket_num;
+	m_data_size = data_size;
+	return true;
+}
+
+inline SharedCache::IndexEntry* SharedCache::GetBucket(uint32_t shard_idx, uint64_t bucket_idx) const
+{
+	IndexEntry* index = (IndexEntry*)(m_shm.Data() + HeadSize(m_shard_num));
+	return index + (shard_idx * m_bucket_num + bucket_idx) * SHARED_CACHE_WAYS;
+}
+
+inline byte_t* SharedCache::GetData(uint32_t shard_idx) const
+{
+	uint64_t index_size = (uint64_t)m_shard_num * m_bucket_num * SHARED_CACHE_WAYS * sizeof(IndexEntry);
+	return m_shm.Data() + HeadSize(m_shard_num) + index_size + shard_idx * m_data_size;
+}
+
+void SharedCache::Lock(Shard* shard, uint32_t shard_idx)
+{
+	if(pthread_mutex_lock(&shard->mutex) == EOWNERDEAD)
+	{
+		//持锁进程异常退出，该片可能不一致，直接清空
+		memset(GetBucket(shard_idx, 0), 0x00, m_bucket_num * SHARED_CACHE_WAYS * sizeof(IndexEntry));
+		shard->write_pos += m_data_size;
+		pthread_mutex_consistent(&shard->mutex);
+	}
+}
+
+SharedCache::IndexEntry* SharedCache::Find(Shard* shard, uint32_t shard_idx, uint64_t tag, const std::string& key, const byte_t** value, uint32_t* value_size)
+{
+	IndexEntry* bucket = GetBucket(shard_idx, (tag >> 8) % m_bucket_num);
+	const byte_t* data = GetData(shard_idx);
+	for(uint32_t i = 0; i < SHARED_CACHE_WAYS; ++i)
+	{
+		IndexEntry* entry = &bucket[i];
+		if(entry->tag != tag || entry->pos + m_data_size < shard->write_pos)
+		{
+			continue;
+		}
+		const EntryHead* head = (const EntryHead*)(data + entry->pos % m_data_size);
+		if(head->tag != tag || head->key_size != key.size() || memcmp(head + 1, key.data(), key.size()) != 0)
+		{
+			continue;
+		}
+		*value = (const byte_t*)(head + 1) + head->key_size;
+		*value_size = head->value_size;
+		return entry;
+	}
+	return nullptr;
+}
+
+void SharedCache::Add(const std::string& key, const std::string& value, size_t value_size)
+{
+	assert(m_shm.Opened());
+	uint64_t entry_size = AlignUp(sizeof(EntryHead) + key.size() + value.size());
+	if(entry_size > m_data_size / 4)
+	{
+		return;
+	}
+	uint64_t tag = HashTag(key);
+	uint32_t shard_idx = tag % m_shard_num;
+	Shard* shard = (Shard*)(m_shm.Data() + HeadSize(0) + shard_idx * 64);
+
+	Lock(shard, shard_idx);
+
+	const byte_t* old_value;
+	uint32_t old_size;
+	if(Find(shard, shard_idx, tag, key, &old_value, &old_size) != nullptr)
+	{
+		pthread_mutex_unlock(&shard->mutex);
+		return;
+	}
+
+	//不跨越数据区尾部
+	uint64_t pos = shard->write_pos;
+	if(pos % m_data_size + entry_size > m_data_size)
+	{
+		pos += m_data_size - pos % m_data_size;
+	}
+	shard->write_pos = pos + entry_size;
+
+	EntryHead* head = (EntryHead*)(GetData(shard_idx) + pos % m_data_size);
+	head->tag = tag;
+	head->key_size = key.size();
+	head->value_size = value.size();
+	memcpy(head + 1, key.data(), key.size());
+	memcpy((byte_t*)(head + 1) + key.size(), value.data(), value.size());
+
+	//优先替换空项或已被覆盖的项，否则替换最老的项
+	IndexEntry* bucket = GetBucket(shard_idx, (tag >> 8) % m_bucket_num);
+	IndexEntry* victim = &bucket[0];
+	for(uint32_t i = 0; i < SHARED_CACHE_WAYS; ++i)
+	{
+		IndexEntry* entry = &bucket[i];
+		if(entry->tag == 0 || entry->pos + m_data_size < shard->write_pos)
+		{
+			victim = entry;
+			break;
+		}
+		if(entry->pos < victim->pos)
+		{
+			victim = entry;
+		}
+	}
+	victim->tag = tag;
+	victim->pos = pos;
+
+	pthread_mutex_unlock(&shard->mutex);
+}
+
+bool SharedCache::Get(const std::string& key, std::string& value)
+{
+	assert(m_shm.Opened());
+	uint64_t tag = HashTag(key);
+	uint32_t shard_idx = tag % m_shard_num;
+	Shard* shard = (Shard*)(m_shm.Data() + HeadSize(0) + shard_idx * 64);
+
+	Lock(shard, shard_idx);
+
+	const byte_t* data;
+	uint32_t size;
+	bool found = (Find(shard, shard_idx, tag, key, &data, &size) != nullptr);
+	if(found)
+	{
+		value.assign((const char*)data, size);
+	}
+
+	pthread_mutex_unlock(&shard->mutex);
+	return found;
+}
+
+} 
+
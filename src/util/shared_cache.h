@@ -0,0 +1,75 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#ifndef __xfutil_shared_cache_h__
+#define __xfutil_shared_cache_h__
+
+#include <string>
+#include <pthread.h>
+#include "xfdb/strutil.h"
+#include "file.h"
+
+namespace xfutil 
+{
+
+//多进程共享的cache，数据放在共享映射的文件中（通常位于/dev/shm），同一主机上映射同一文件的进程共用
+//分片，每片一个进程间互斥锁（持有者异常退出时清空该片）、组相联的hash索引和环形数据区，按写入顺序淘汰
+class SharedCache
+{
+public:
+	SharedCache();
+	~SharedCache();
+
+public:
+	/**映射file_path，不存在时按max_size创建；已有文件的参数与max_size不一致时失败*/
+	bool Open(const char* file_path, size_t max_size);
+
+	inline bool Opened() const
+	{
+		return m_shm.Opened();
+	}
+
+	void Add(const std::string& key, const std::string& value, size_t value_size);
+	bool Get(const std::string& key, std::string& value);
+
+private:
+	struct Header;
+	struct Shard;
+	struct IndexEntry;
+
+	static void GetLayout(size_t max_size, uint32_t& shard_num, uint64_t& bucket_num, uint64_t& data_size);
+
+	void Lock(Shard* shard, uint32_t shard_idx);
+	IndexEntry* Find(Shard* shard, uint32_t shard_idx, uint64_t tag, const std::string& key, const byte_t** value, uint32_t* value_size);
+
+	inline IndexEntry* GetBucket(uint32_t shard_idx, uint64_t bucket_idx) const;
+	inline byte_t* GetData(uint32_t shard_idx) const;
+
+private:
+	SharedMemory m_shm;
+	uint32_t m_shard_num;
+	uint64_t m_bucket_num;		//每片的索引桶数
+	uint64_t m_data_size;		//每片的数据区大小
+
+private:
+	SharedCache(const SharedCache&) = delete;
+	SharedCache& operator=(const SharedCache&) = delete;
+};
+
+} 
+
+#endif
+
@@ -14,6 +14,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ***************************************************************************/
 
+#include <algorithm>
+#include <atomic>
 #include "thread.h"
 
 namespace xfutil
@@ -53,6 +55,43 @@ void ThreadGroup::Join()
     }
 }
 
-}
+static thread_local bool t_in_parallel_for = false;
+
+void ParallelFor(size_t task_count, size_t thread_count, const std::function<void(size_t)>& task)
+{
+    //嵌套调用时不再创建线程，避免线程数成倍增长
+    thread_count = std::min(thread_count, task_count);
+    if(thread_count <= 1 || t_in_parallel_for)
+    {
+        for(size_t i = 0; i < task_count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<size_t> next_idx(0);
+    auto worker = [&]()
+    {
+        t_in_parallel_for = true;
+        for(size_t i = next_idx++; i < task_count; i = next_idx++)
+        {
+            task(i);
+        }
+        t_in_parallel_for = false;
+    };
 
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count-1);
+    for(size_t i = 1; i < thread_count; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(auto& th : threads)
+    {
+        th.join();
+    }
+}
 
+}
@@ -20,6 +20,7 @@ limitations under the License.
 #include <thread>
 #include <mutex>
 #include <vector>
+#include <functional>
 #include "xfdb/strutil.h"
 #include <unistd.h>
 #include <sys/syscall.h>
@@ -96,6 +97,10 @@ private:
 		
 };
 
+/**用最多thread_count个临时线程执行task(0)~task(task_count-1)，全部完成后返回；
+   thread_count<=1或在ParallelFor的任务中嵌套调用时，在当前线程顺序执行*/
+void ParallelFor(size_t task_count, size_t thread_count, const std::function<void(size_t)>& task);
+
 }
 
 #endif
@@ -0,0 +1,124 @@
+/*************************************************************************
+Copyright (C) 2022 The xfdb Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+***************************************************************************/
+
+#include <unistd.h>
+#include <random>
+#include <string>
+#include "xfdb.h"
+
+using namespace xfutil;
+using namespace xfdb;
+
+//测试bottom rewrite的触发：随机插入新key时不应重写不参与merge的segment，覆盖写老key超过垃圾占比后才重写
+
+#define BENCH_BUCKET_NAME	"rewrite_bench"
+#define BENCH_VALUE_SIZE	100
+
+static void MakeKey(uint64_t num, char* key, size_t size)
+{
+	snprintf(key, size, "%016lx", num);
+}
+
+//用同一种子生成的前count个随机key
+static Status WriteObjects(DBPtr& db, uint64_t count, uint32_t value_seq)
+{
+	std::mt19937_64 gen(1);
+	std::string value(BENCH_VALUE_SIZE, 'v');
+	char key[32];
+	for(uint64_t i = 0; i < count; ++i)
+	{
+		MakeKey(gen(), key, sizeof(key));
+		snprintf(&value[0], value.size(), "%u_%lu", value_seq, i);
+		Status s = db->Set(BENCH_BUCKET_NAME, StrView(key), StrView(value.data(), value.size()));
+		if(s != OK)
+		{
+			return s;
+		}
+	}
+	return db->Flush(BENCH_BUCKET_NAME);
+}
+
+static void PrintStat(DBPtr& db, const char* phase, uint32_t wait_s)
+{
+	//等待合并及至少一次bottom rewrite检测完成
+	sleep(wait_s);
+
+	BucketStat stat;
+	if(db->GetBucketStat(BENCH_BUCKET_NAME, stat) != OK)
+	{
+		printf("%s: get stat failed\n", phase);
+		return;
+	}
+	printf("%s: segment num: %lu, segment size: %lu, rewrite num: %lu, rewrite size: %lu\n", phase,
+		stat.segment_stat.count, stat.segment_stat.size, stat.rewrite_stat.count, stat.rewrite_stat.size);
+}
+
+int main(int argc, char* argv[])
+{
+	//usage: rewrite_bench_tool <db_path> <object_count> <update_percent>
+	if(argc != 4)
+	{
+		printf("usage: %s <db_path> <object_count> <update_percent>\n", argv[0]);
+		return 1;
+	}
+	std::string db_path(argv[1]);
+	uint64_t object_count = atoll(argv[2]);
+	uint32_t update_percent = atoi(argv[3]);
+
+	GlobalConfig gconf;
+	gconf.mode = MODE_READWRITE;
+	gconf.notify_dir = "./notify";
+	gconf.max_memtable_objects = 10000;
+	gconf.max_merge_size = MB(4);
+	gconf.clean_interval_s = 1;
+	gconf.bottom_rewrite_interval_s = 1;
+	Status s = Start(gconf);
+	if(s != OK)
+	{
+		printf("xfdb init failed, status: %d\n", s);
+		return 2;
+	}
+
+	DBConfig dbconf;
+	DBPtr db;
+	s = DB::Open(dbconf, db_path, db);
+	if(s != OK)
+	{
+		printf("db open failed, path:%s, status: %d\n", db_path.c_str(), s);
+		return 2;
+	}
+	db->CreateBucket(BENCH_BUCKET_NAME);
+
+	//新key随机分布，更新的segment与所有大segment的key范围都重叠，但不覆盖其中的key
+	s = WriteObjects(db, object_count, 0);
+	if(s != OK)
+	{
+		printf("insert failed, status: %d\n", s);
+		return 3;
+	}
+	PrintStat(db, "random insert", 5);
+
+	s = WriteObjects(db, object_count * update_percent / 100, 1);
+	if(s != OK)
+	{
+		printf("update failed, status: %d\n", s);
+		return 3;
+	}
+	PrintStat(db, "update", 5);
+
+	return 0;
+}
+